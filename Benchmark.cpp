@@ -0,0 +1,888 @@
+// microbenchmarks for the core engine routines. Build this file on its own in place of Source.cpp (which it includes) to get a
+// console program that times each routine on synthetic inputs of increasing size. Nothing is drawn: sprites are left null so that
+// every render call returns straight away and only the game logic is timed. Each figure is the median of several runs, per call.
+//
+// Benchmark stress plays generated levels of increasing size and entity count through the game loop and prints a csv of frame rate,
+// phase times and peak heap use. It spreads instance updates over every core, or over as many threads as given (Benchmark stress 1
+// keeps them on the main thread, for comparison). Benchmark generate writes one such level to use in the game, and Benchmark replay
+// plays on from a snapshot such as the hitch.snap the game writes after a slow frame (run those two without arguments for usage).
+//
+// Benchmark allocs counts the heap allocations made in each phase of every frame of play and fails if a frame allocates once play
+// has settled, so that the frame loop can be kept off the heap.
+#define BENCHMARK
+#include "Source.cpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+
+
+
+
+
+
+// ------------------------------ALLOCATION COUNTING------------------------------
+
+// atomic as the job system's workers allocate too
+static std::atomic<size_t> g_allocs{ 0 };
+static std::atomic<size_t> g_allocBytes{ 0 };
+static std::atomic<size_t> g_liveBytes{ 0 };
+static std::atomic<size_t> g_peakBytes{ 0 };
+static std::atomic<size_t> g_phaseAllocs[PHASE_COUNT + 1]{}; // allocations made in each phase since they were last taken, the last slot outside any
+static std::atomic<size_t> g_phaseBytes[PHASE_COUNT + 1]{};
+const size_t allocHeader{ alignof(std::max_align_t) }; // room in front of each block for its size, keeping the block aligned
+
+
+// every heap allocation in the program goes through here, so the benchmarks can report how many each routine makes and how much
+// memory is held at most
+void* operator new(std::size_t size)
+{
+	int phase{ g_phase.load(std::memory_order_relaxed) };
+	g_allocs++;
+	g_allocBytes += size;
+	g_phaseAllocs[phase]++;
+	g_phaseBytes[phase] += size;
+	size_t live{ g_liveBytes += size };
+	size_t peak{ g_peakBytes };
+	while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live))
+		;
+	if (char *block = static_cast<char*>(std::malloc(size + allocHeader)))
+	{
+		*reinterpret_cast<std::size_t*>(block) = size;
+		return block + allocHeader;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept
+{
+	if (!ptr)
+		return;
+	char *block{ static_cast<char*>(ptr) - allocHeader };
+	g_liveBytes -= *reinterpret_cast<std::size_t*>(block);
+	std::free(block);
+}
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+
+// the allocations made in a frame of play, by phase
+struct FrameAllocs
+{
+	size_t allocs[PHASE_COUNT + 1];
+	size_t bytes[PHASE_COUNT + 1];
+	size_t total() const { return std::accumulate(allocs, allocs + PHASE_COUNT + 1, static_cast<size_t>(0)); }
+};
+
+
+// takes the allocations made in each phase since the last call, starting the count again
+FrameAllocs takeAllocs()
+{
+	FrameAllocs taken;
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+	{
+		taken.allocs[i] = g_phaseAllocs[i].exchange(0);
+		taken.bytes[i] = g_phaseBytes[i].exchange(0);
+	}
+	return taken;
+}
+
+
+
+
+
+
+// ------------------------------HARNESS------------------------------
+
+const int benchRuns{ 9 }; // timed runs of each case, the median is reported
+const int benchFrames{ 60 }; // frames simulated per run of an update benchmark
+const int benchHeight{ 16 }; // rows in the generated levels
+volatile int g_sink{ 0 }; // results are written here so that the work can't be optimised away
+
+
+// the cost of one call to a routine
+struct Result
+{
+	double ns;
+	double allocs;
+	double bytes;
+};
+
+
+// runs body (which makes calls calls) once to warm up then benchRuns times, returning the run with the median time
+template <typename F>
+Result measure(F body, int calls)
+{
+	body();
+	std::vector<Result> runs;
+	for (int r{ 0 }; r < benchRuns; r++)
+	{
+		size_t allocs{ g_allocs };
+		size_t bytes{ g_allocBytes };
+		auto start{ std::chrono::steady_clock::now() };
+		body();
+		auto end{ std::chrono::steady_clock::now() };
+		double ns{ static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) };
+		runs.push_back({ ns / calls, static_cast<double>(g_allocs - allocs) / calls, static_cast<double>(g_allocBytes - bytes) / calls });
+	}
+	std::sort(runs.begin(), runs.end(), [](const Result &left, const Result &right) { return left.ns < right.ns; });
+	return runs[benchRuns / 2];
+}
+
+
+void report(const char *name, const char *param, int size, Result result)
+{
+	char label[64];
+	snprintf(label, sizeof(label), "%s %s=%d", name, param, size);
+	printf("%-36s %12.1f ns %10.2f allocs %12.1f bytes\n", label, result.ns, result.allocs, result.bytes);
+}
+
+
+// writes a level file of the given width with a floor, a pillar every 16 columns and dynamic tiles on roughly density of the
+// cells above the floor. codes are the tile codes to scatter. A fixed seed keeps the level the same from run to run.
+void writeLevel(const std::string &path, int width, int tileSet, double density, const std::vector<int> &codes)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << '0' << '0' << tileSet << '\n';
+	unsigned int seed{ 12345 };
+	for (int y{ 0 }; y < benchHeight; y++)
+	{
+		std::string row(width, 'a');
+		for (int x{ 0 }; x < width; x++)
+		{
+			seed = seed * 1103515245 + 12345;
+			if (y >= benchHeight - 2 || (x % 16 == 0 && y == benchHeight - 3))
+				row[x] = 'a' + 1; // wall
+			else if (y >= 2 && !codes.empty() && (seed >> 8) % 1000 < density * 1000)
+				row[x] = 'a' + codes[(seed >> 20) % codes.size()];
+		}
+		file << row << '\n';
+	}
+}
+
+
+// tile codes (in tileset 0) of every dynamic type
+const std::vector<int> dynamicCodes{ 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+
+
+
+
+
+
+// ------------------------------BENCHMARKS------------------------------
+
+void benchCollided()
+{
+	for (int size{ 16 }; size <= 256; size *= 2)
+	{
+		SDL_Rect left{ 0, 0, size, size };
+		SDL_Rect miss{ size + 32, 0, 32, 32 }; // every sample point is tested
+		SDL_Rect hit{ size - 8, size - 8, 32, 32 }; // only the last few sample points overlap
+		report("collided miss", "size", size, measure([&] { for (int i{ 0 }; i < 1000; i++) g_sink += collided(left, miss); }, 1000));
+		report("collided hit", "size", size, measure([&] { for (int i{ 0 }; i < 1000; i++) g_sink += collided(left, hit); }, 1000));
+	}
+}
+
+
+void benchAlign()
+{
+	for (int depth{ 1 }; depth <= 256; depth *= 4)
+	{
+		SDL_Rect wall{ 256, 0, 512, 32 };
+		report("align", "depth", depth, measure([&] {
+			for (int i{ 0 }; i < 1000; i++)
+			{
+				SDL_Rect rect{ 228 + depth, 0, 28, 32 }; // overlaps the wall by depth pixels and is pushed back one pixel at a time
+				g_sink += align(rect, wall, 1, 0);
+			}
+		}, 1000));
+	}
+}
+
+
+void benchGetIndex()
+{
+	for (int size{ 16 }; size <= 4096; size *= 4)
+	{
+		std::vector<Object*> objects;
+		for (int i{ 0 }; i < size; i++)
+			objects.push_back(reinterpret_cast<Object*>(static_cast<intptr_t>(i + 1) * 64));
+		Object *last{ objects.back() };
+		Object *missing{ nullptr };
+		report("getIndex last", "size", size, measure([&] { for (int i{ 0 }; i < 100; i++) g_sink += getIndex(&objects, last); }, 100));
+		report("getIndex missing", "size", size, measure([&] { for (int i{ 0 }; i < 100; i++) g_sink += getIndex(&objects, missing); }, 100));
+	}
+}
+
+
+// the player tested against count enemies one at a time with collided() and then as one batch, and the batched proximity tests
+void benchBatch()
+{
+	for (int count{ 16 }; count <= 4096; count *= 4)
+	{
+		SDL_Rect player{ 320, 240, 28, 32 };
+		RectBatch batch;
+		std::vector<int> ranges;
+		for (int i{ 0 }; i < count; i++)
+		{
+			batch.push({ (i * 37) % 640, (i * 53) % 480, 32, 32 });
+			ranges.push_back(viewRangeH * 32);
+		}
+		std::vector<Uint8> hits;
+		std::vector<float> dist2;
+		std::vector<Uint8> inRange;
+		report("collided each", "enemies", count, measure([&] {
+			for (int i{ 0 }; i < count; i++)
+			{
+				SDL_Rect rect{ batch.x[i], batch.y[i], batch.w[i], batch.h[i] };
+				g_sink += collided(player, rect);
+			}
+		}, count));
+		report("overlapKernel", "enemies", count, measure([&] { overlapKernel(player, batch, hits); g_sink += hits[0]; }, count));
+		report("proximityKernel", "enemies", count, measure([&] {
+			proximityKernel(336, 240, 320, 240, viewRangeV * 32, batch, ranges, dist2, inRange);
+			g_sink += inRange[0];
+		}, count));
+	}
+}
+
+
+// one frame of rain, moving every falling drop and filling them in one call, against how many are falling
+void benchRain()
+{
+	for (float density : { 0.25f, 0.5f, 1.0f })
+	{
+		Rain rain;
+		rain.setDensity(density);
+		int drops{ static_cast<int>(density * 1024) };
+		int view{ 0 };
+		report("Rain::update and draw", "drops", drops, measure([&] { rain.update(view += 3); rain.draw(nullptr); }, drops));
+	}
+}
+
+
+// Level::load on its own only indexes the file, building the level means streaming every chunk in turn
+void benchLevel()
+{
+	int tileSet;
+	bool weather;
+	int track;
+	for (int width{ 256 }; width <= 16384; width *= 4)
+	{
+		writeLevel("bench_level.txt", width, 0, 0.05, dynamicCodes);
+		Level level;
+		report("Level::load", "width", width, measure([&] { g_sink += level.load("bench_level.txt", nullptr, &tileSet, &weather, &track); }, 1));
+		int chunks{ width / chunkW + 1 };
+		report("level build per chunk", "width", width, measure([&] {
+			level.load("bench_level.txt", nullptr, &tileSet, &weather, &track);
+			for (int gridx{ 0 }; gridx < width + chunkW; gridx += chunkW)
+				level.stream(gridx);
+		}, chunks));
+	}
+	remove("bench_level.txt");
+}
+
+
+void benchGroupInstance()
+{
+	for (int count{ 16 }; count <= 4096; count *= 4)
+	{
+		std::vector<Object*> objects;
+		for (int i{ 0 }; i < count; i++)
+			objects.push_back(tileInfo[tileTypeOf(0, dynamicCodes[i % dynamicCodes.size()])].spawn(i * 32, 0, nullptr));
+		std::vector<Object*> instances, solids, hazards, enemies, collectibles;
+		report("groupInstance", "objects", count, measure([&] {
+			instances.clear();
+			solids.clear();
+			hazards.clear();
+			enemies.clear();
+			collectibles.clear();
+			for (Object *ptr : objects)
+				groupInstance(ptr, instances, solids, hazards, enemies, collectibles);
+		}, count));
+		for (Object *ptr : objects)
+			delete ptr;
+	}
+}
+
+
+// the player walking across a level one column at a time, rebuilding the active region at every step
+void benchRegion()
+{
+	int tileSet;
+	bool weather;
+	int track;
+	const int width{ 1024 };
+	for (int percent{ 1 }; percent <= 64; percent *= 4)
+	{
+		writeLevel("bench_region.txt", width, 0, percent / 100.0, dynamicCodes);
+		Level level;
+		level.load("bench_region.txt", nullptr, &tileSet, &weather, &track);
+		std::vector<Object*> protQueue, instances, solids, hazards, enemies, collectibles;
+		report("rebuildRegion", "density%", percent, measure([&] {
+			for (int gridx{ 0 }; gridx < width; gridx++)
+				rebuildRegion(level, gridx, benchHeight / 2, protQueue, instances, solids, hazards, enemies, collectibles);
+		}, width));
+	}
+	remove("bench_region.txt");
+}
+
+
+// saving the world at the start of a level into a snapshot and recording it in the history, and loading it back, against how many
+// dynamic objects the level holds
+void benchSnapshot()
+{
+	int tileSet;
+	bool weather;
+	int track;
+	for (int percent{ 1 }; percent <= 64; percent *= 4)
+	{
+		writeLevel("bench_snapshot.txt", 1024, 0, percent / 100.0, dynamicCodes);
+		Level level;
+		level.load("bench_snapshot.txt", nullptr, &tileSet, &weather, &track);
+		Session session;
+		session.start(level, weather);
+		Snapshot snapshot;
+		SnapshotRing history;
+		report("snapshot save and record", "density%", percent, measure([&] {
+			snapshot.beginSave();
+			session.sync(snapshot);
+			history.record(snapshot.bytes());
+		}, 1));
+		report("snapshot restore", "density%", percent, measure([&] { g_sink += session.restore(snapshot); }, 1));
+	}
+	remove("bench_snapshot.txt");
+}
+
+
+// aiming shots one at a time and in batches of count, at targets scattered around the shooters within and beyond reach
+void benchBallistics()
+{
+	for (int count{ 16 }; count <= 1024; count *= 8)
+	{
+		std::vector<double> x(count), y(count), targetx(count), targety(count);
+		std::vector<Aim> out(count);
+		unsigned int seed{ 12345 };
+		for (int i{ 0 }; i < count; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			targetx[i] = static_cast<int>((seed >> 8) % 800) - 400;
+			seed = seed * 1103515245 + 12345;
+			targety[i] = static_cast<int>((seed >> 8) % 400) - 200;
+		}
+		report("Ballistics::aim", "count", count, measure([&] {
+			for (int i{ 0 }; i < count; i++)
+				g_sink += g_ballistics.aim(x[i], y[i], targetx[i], targety[i]).reachable;
+		}, count));
+		report("Ballistics::aim batch", "count", count, measure([&] {
+			g_ballistics.aim(count, x.data(), y.data(), targetx.data(), targety.data(), out.data());
+			g_sink += out[0].reachable;
+		}, count));
+	}
+}
+
+
+// count instances of one type updated together for benchFrames frames on a floored level, reported per instance update
+void benchUpdate(const char *name, Uint8 type)
+{
+	int tileSet;
+	bool weather;
+	int track;
+	writeLevel("bench_update.txt", 64, 0, 0, {});
+	Level level;
+	level.load("bench_update.txt", nullptr, &tileSet, &weather, &track);
+	level.stream(20);
+	g_levelW = level.width();
+	g_levelH = level.height();
+	for (int count{ 1 }; count <= 256; count *= 16)
+	{
+		Player player{ 20 * 32, (benchHeight - 3) * 32 };
+		player.v_x = screenw / 2;
+		player.v_y = screenh / 2 + 64;
+		std::vector<Object*> instances, solids, hazards, enemies, collectibles;
+		for (int i{ 0 }; i < count; i++)
+			groupInstance(tileInfo[type].spawn((2 + i % 30) * 32, (benchHeight - 4) * 32, nullptr), instances, solids, hazards, enemies,
+				collectibles);
+		report(name, "count", count, measure([&] {
+			for (int frame{ 0 }; frame < benchFrames; frame++)
+			{
+				g_count++;
+				updateProximity(instances, player);
+				for (Object *ptr : instances)
+					ptr->update(nullptr, level, &player, &solids, &hazards);
+			}
+		}, benchFrames * count));
+		for (Object *ptr : instances)
+			delete ptr;
+	}
+	remove("bench_update.txt");
+}
+
+
+
+
+
+
+// ------------------------------STRESS LEVELS------------------------------
+
+// what a generated level contains
+struct StressParams
+{
+	int width{ 256 };
+	int height{ 16 };
+	double wallDensity{ 0.05 }; // chance of each cell above the floor being a low wall block
+	int snakes{ 0 };
+	int frogs{ 0 };
+	int plants{ 0 };
+	int spits{ 0 };
+	int yetis{ 0 };
+	int mammoths{ 0 };
+};
+
+
+// writes a level in the same format as the shipped ones: a floor, scattered wall blocks at most two high that a jump clears, and the
+// given number of each enemy placed at random on the floor. Yeti and mammoth only have tile codes in tileset 1 and the rest only in
+// tileset 0, so a level with either of the first two is written in tileset 1 and the others are left out. Returns false if the file
+// couldn't be written.
+bool writeStressLevel(const std::string &path, const StressParams &params, unsigned int seed)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+	int tileSet{ params.yetis > 0 || params.mammoths > 0 };
+	std::vector<std::string> rows(params.height, std::string(params.width, 'a'));
+	auto random = [&seed](int range) { seed = seed * 1103515245 + 12345; return static_cast<int>((seed >> 8) % range); };
+	int floor{ params.height - 2 };
+	for (int x{ 0 }; x < params.width; x++)
+	{
+		rows[floor][x] = rows[floor + 1][x] = 'a' + 1;
+		// the start and end of the level are kept clear
+		if (x > 4 && x < params.width - 4 && random(1000) < params.wallDensity * 1000)
+		{
+			rows[floor - 1][x] = 'a' + 1;
+			if (random(2))
+				rows[floor - 2][x] = 'a' + 1;
+		}
+	}
+	// places count of the tile code on free floor cells, giving up on a cell after a few tries if the level is crowded. A type size
+	// cells across and high needs all of them free, and its code goes in the top left one.
+	auto place = [&](int code, int count, int size) {
+		auto free = [&](int x, int y) {
+			for (int dy{ 0 }; dy < size; dy++)
+				for (int dx{ 0 }; dx < size; dx++)
+					if (rows[y + dy][x + dx] != 'a')
+						return false;
+			return true;
+		};
+		for (int i{ 0 }; i < count; i++)
+			for (int tries{ 0 }; tries < 8; tries++)
+			{
+				int x{ 8 + random(std::max(1, params.width - 16)) };
+				int y{ floor - 1 };
+				while (y > 0 && rows[y][x] != 'a')
+					y--;
+				y -= size - 1;
+				if (y > 0 && free(x, y))
+				{
+					rows[y][x] = 'a' + code;
+					break;
+				}
+			}
+	};
+	if (tileSet == 0)
+	{
+		place(6, params.snakes, 1);
+		place(13, params.frogs, 1);
+		place(8, params.plants, 1);
+		place(9, params.spits, 1);
+	}
+	else
+	{
+		place(9, params.yetis, 1);
+		place(8, params.mammoths, 2);
+	}
+	file << '0' << '0' << tileSet << '\n';
+	for (const std::string &row : rows)
+		file << row << '\n';
+	return true;
+}
+
+
+static const int stressFrames{ 1800 }; // frames played of each stress level, unless its end is reached first
+static int g_stressFrame{ 0 };
+static double g_stressPhases[PHASE_COUNT + 1];
+static size_t g_stressAllocs{ 0 };
+static std::vector<Uint8> g_scriptKeys(SDL_NUM_SCANCODES, 0);
+
+
+// the scripted input path, run after every frame played: hold right the whole way and jump every 40 frames, holding it for 24 to
+// clear wall blocks. Escape is pressed once the frame budget is spent.
+void stressFrame()
+{
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+		g_stressPhases[i] += g_profiler.last(i);
+	g_stressAllocs += takeAllocs().total();
+	g_stressFrame++;
+	g_scriptKeys[SDL_SCANCODE_RIGHT] = 1;
+	g_scriptKeys[SDL_SCANCODE_SPACE] = g_stressFrame % 40 < 24;
+	g_scriptKeys[SDL_SCANCODE_ESCAPE] = g_stressFrame >= stressFrames;
+}
+
+
+// plays one generated level through a Session and prints a csv row of its results
+void runStress(SDL_Renderer *ren, GlyphAtlas &text, const StressParams &params, int entities)
+{
+	if (!writeStressLevel("bench_stress.txt", params, 12345))
+	{
+		printf("couldn't write bench_stress.txt\n");
+		return;
+	}
+	int tileSet;
+	bool weather;
+	int track;
+	size_t baseBytes{ g_liveBytes };
+	g_peakBytes = baseBytes;
+	Level *level{ new Level };
+	level->load("bench_stress.txt", ren, &tileSet, &weather, &track);
+	g_stressFrame = 0;
+	std::fill(g_stressPhases, g_stressPhases + PHASE_COUNT + 1, 0);
+	std::fill(g_scriptKeys.begin(), g_scriptKeys.end(), 0);
+	g_stressAllocs = 0;
+	takeAllocs();
+	auto start{ std::chrono::steady_clock::now() };
+	Session session;
+	session.start(*level, weather);
+	while (session.frame(ren, text) == 0)
+		;
+	auto end{ std::chrono::steady_clock::now() };
+	delete level;
+	double seconds{ std::chrono::duration<double>(end - start).count() };
+	int frames{ std::max(g_stressFrame, 1) };
+	printf("%d,%d,%d,%d,%d,%.1f", params.width, params.height, tileSet, entities, g_stressFrame, g_stressFrame / seconds);
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+		printf(",%.4f", g_stressPhases[i] / frames);
+	printf(",%.1f,%zu\n", static_cast<double>(g_stressAllocs) / frames, (g_peakBytes - baseBytes) / 1024);
+	fflush(stdout);
+}
+
+
+// sets up to play levels as the game does. Drawing is part of what is measured, so a real (hidden) window is used where one can be
+// made, and its renderer returned.
+SDL_Renderer* openGame(SDL_Window **win, GlyphAtlas &text)
+{
+	SDL_Init(SDL_INIT_VIDEO);
+	TTF_Init();
+	IMG_Init(IMG_INIT_PNG);
+	*win = SDL_CreateWindow("Dino", 0, 0, screenw, screenh + 64, SDL_WINDOW_HIDDEN);
+	SDL_Renderer *ren{ *win ? SDL_CreateRenderer(*win, -1, SDL_RENDERER_ACCELERATED) : nullptr };
+	if (*win)
+		g_format = SDL_GetWindowPixelFormat(*win);
+	if (!ren)
+		fprintf(stderr, "no renderer, only game logic is timed\n");
+	loadImages(ren);
+	Player::m_sounds = { nullptr, nullptr }; // g_audio is never started, so every sound is dropped unplayed
+	text.build(ren, TTF_OpenFont("arcadeclassic/ARCADECLASSIC.ttf", 36));
+	keys = g_scriptKeys.data();
+	g_invulnerable = true;
+	g_hitchMs = 0;
+	return ren;
+}
+
+
+void closeGame(SDL_Window *win, SDL_Renderer *ren, GlyphAtlas &text)
+{
+	text.destroy();
+	g_hud.destroy();
+	g_resources.destroyAll();
+	if (ren)
+		SDL_DestroyRenderer(ren);
+	if (win)
+		SDL_DestroyWindow(win);
+	TTF_Quit();
+	IMG_Quit();
+	SDL_Quit();
+}
+
+
+// plays levels of increasing width and entity count, printing a csv with a row per level
+int stress(int threads)
+{
+	g_jobs.start(threads);
+	SDL_Window *win;
+	GlyphAtlas text;
+	SDL_Renderer *ren{ openGame(&win, text) };
+	g_frameHook = stressFrame;
+
+	printf("width,height,tileset,entities,frames,fps");
+	for (const char *name : phaseNames)
+		printf(",%s ms", name);
+	printf(",FRAME ms,allocs/frame,peak KB\n");
+	for (int width{ 256 }; width <= 4096; width *= 4)
+		for (int perType{ 0 }; perType <= 256; perType = perType ? perType * 4 : 4)
+		{
+			// one sweep of each world's enemies
+			StressParams world1;
+			world1.width = width;
+			world1.snakes = world1.frogs = world1.plants = world1.spits = perType;
+			runStress(ren, text, world1, perType * 4);
+			StressParams world2;
+			world2.width = width;
+			world2.yetis = world2.mammoths = perType;
+			runStress(ren, text, world2, perType * 2);
+		}
+	remove("bench_stress.txt");
+	closeGame(win, ren, text);
+	return 0;
+}
+
+
+static int g_replayFrames{ 0 };
+
+
+// the replay's frame hook: no keys are held, and escape is pressed once the frames asked for have been played
+void replayFrame()
+{
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+		g_stressPhases[i] += g_profiler.last(i);
+	g_scriptKeys[SDL_SCANCODE_ESCAPE] = ++g_stressFrame >= g_replayFrames;
+}
+
+
+// plays on from a snapshot of a level, such as the hitch.snap the game writes after a slow frame, with no input held. Prints the
+// average time of each phase, so a hitch can be looked into away from the game.
+int replay(const char *levelFile, const char *snapshotFile, int frames)
+{
+	g_jobs.start(std::thread::hardware_concurrency());
+	SDL_Window *win;
+	GlyphAtlas text;
+	SDL_Renderer *ren{ openGame(&win, text) };
+	g_frameHook = replayFrame;
+	g_replayFrames = frames;
+	int tileSet;
+	bool weather;
+	int track;
+	Level level;
+	Snapshot snapshot;
+	if (!level.load(levelFile, ren, &tileSet, &weather, &track) || !snapshot.read(snapshotFile))
+	{
+		printf("couldn't read %s or %s\n", levelFile, snapshotFile);
+		closeGame(win, ren, text);
+		return 1;
+	}
+	Session session;
+	session.start(level, weather);
+	int result{ 0 };
+	if (session.restore(snapshot))
+	{
+		while (session.frame(ren, text) == 0)
+			;
+		int played{ std::max(g_stressFrame, 1) };
+		for (int i{ 0 }; i <= PHASE_COUNT; i++)
+			printf("%-12s %8.4f ms\n", i < PHASE_COUNT ? phaseNames[i] : "FRAME", g_stressPhases[i] / played);
+	}
+	else
+	{
+		printf("%s isn't a snapshot of %s\n", snapshotFile, levelFile);
+		result = 1;
+	}
+	closeGame(win, ren, text);
+	return result;
+}
+
+
+static const int allocWarmup{ 120 }; // frames of each level played before its allocations count, letting buffers grow to their working size
+static int g_allocFrames{ 0 };
+static std::vector<FrameAllocs> g_frameAllocs;
+
+
+// the allocation check's frame hook: no keys are held, so the view stays put and no chunks are streamed, making every frame after
+// the warm up a steady state one. Escape is pressed once the frames asked for have been played.
+void allocFrame()
+{
+	g_frameAllocs.push_back(takeAllocs());
+	g_scriptKeys[SDL_SCANCODE_ESCAPE] = static_cast<int>(g_frameAllocs.size()) + 1 >= allocWarmup + g_allocFrames; // the frame escape is read in is played too
+}
+
+
+// plays a generated level standing still, writing the allocations of each phase of every frame to csv and printing their average
+// over the steady state frames. Returns false if any of those frames allocated.
+bool checkAllocs(SDL_Renderer *ren, GlyphAtlas &text, const char *name, const StressParams &params, std::ofstream &csv)
+{
+	if (!writeStressLevel("bench_allocs.txt", params, 12345))
+	{
+		printf("couldn't write bench_allocs.txt\n");
+		return false;
+	}
+	int tileSet;
+	bool weather;
+	int track;
+	Level *level{ new Level };
+	level->load("bench_allocs.txt", ren, &tileSet, &weather, &track);
+	std::fill(g_scriptKeys.begin(), g_scriptKeys.end(), 0);
+	g_frameAllocs.clear();
+	g_frameAllocs.reserve(allocWarmup + g_allocFrames + 1);
+	takeAllocs();
+	Session session;
+	session.start(*level, weather);
+	while (session.frame(ren, text) == 0)
+		;
+	delete level;
+
+	FrameAllocs sum{};
+	int allocating{ 0 };
+	int first{ -1 };
+	for (int f{ 0 }; f < static_cast<int>(g_frameAllocs.size()); f++)
+	{
+		const FrameAllocs &frame{ g_frameAllocs[f] };
+		bool steady{ f >= allocWarmup };
+		csv << name << ',' << f << ',' << steady;
+		for (int i{ 0 }; i <= PHASE_COUNT; i++)
+			csv << ',' << frame.allocs[i] << ',' << frame.bytes[i];
+		csv << '\n';
+		if (!steady)
+			continue;
+		for (int i{ 0 }; i <= PHASE_COUNT; i++)
+		{
+			sum.allocs[i] += frame.allocs[i];
+			sum.bytes[i] += frame.bytes[i];
+		}
+		if (frame.total())
+		{
+			allocating++;
+			if (first < 0)
+				first = f;
+		}
+	}
+	int steadyFrames{ std::max(static_cast<int>(g_frameAllocs.size()) - allocWarmup, 1) };
+	printf("%s: %d of %d steady state frames allocated\n", name, allocating, steadyFrames);
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+		if (sum.allocs[i])
+			printf("  %-12s %10.2f allocs %12.1f bytes per frame\n", i < PHASE_COUNT ? phaseNames[i] : "OTHER",
+				static_cast<double>(sum.allocs[i]) / steadyFrames, static_cast<double>(sum.bytes[i]) / steadyFrames);
+	if (first >= 0)
+	{
+		printf("  first at frame %d:", first);
+		for (int i{ 0 }; i <= PHASE_COUNT; i++)
+			if (g_frameAllocs[first].allocs[i])
+				printf(" %s %zu (%zu bytes)", i < PHASE_COUNT ? phaseNames[i] : "OTHER", g_frameAllocs[first].allocs[i], g_frameAllocs[first].bytes[i]);
+		printf("\n");
+	}
+	return !allocating;
+}
+
+
+// plays a level of each world's enemies and fails if a frame of play allocates once it has settled, the aim being a frame loop that
+// never touches the heap. Every frame's allocations by phase go to allocs.csv.
+int allocs(int frames)
+{
+	g_jobs.start(std::thread::hardware_concurrency());
+	SDL_Window *win;
+	GlyphAtlas text;
+	SDL_Renderer *ren{ openGame(&win, text) };
+	g_frameHook = allocFrame;
+	g_allocFrames = frames;
+	std::ofstream csv("allocs.csv");
+	csv << "level,frame,steady";
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
+	{
+		const char *name{ i < PHASE_COUNT ? phaseNames[i] : "OTHER" };
+		csv << ',' << name << " allocs," << name << " bytes";
+	}
+	csv << '\n';
+	StressParams world1;
+	world1.snakes = world1.frogs = world1.plants = world1.spits = 16;
+	StressParams world2;
+	world2.yetis = world2.mammoths = 16;
+	bool passed{ checkAllocs(ren, text, "world 1", world1, csv) };
+	passed = checkAllocs(ren, text, "world 2", world2, csv) && passed;
+	remove("bench_allocs.txt");
+	closeGame(win, ren, text);
+	printf(passed ? "PASS\n" : "FAIL\n");
+	return passed ? 0 : 1;
+}
+
+
+
+
+
+
+// ------------------------------MAIN FUNCTION------------------------------
+
+int main(int argc, char **argv)
+{
+	std::string mode{ argc > 1 ? argv[1] : "" };
+	if (mode == "stress")
+		return stress(argc > 2 ? std::max(atoi(argv[2]), 1) : static_cast<int>(std::thread::hardware_concurrency()));
+	if (mode == "replay")
+	{
+		if (argc < 4)
+		{
+			printf("usage: Benchmark replay <level> <snapshot> [frames]\n");
+			return 1;
+		}
+		return replay(argv[2], argv[3], argc > 4 ? std::max(atoi(argv[4]), 1) : 600);
+	}
+	if (mode == "allocs")
+		return allocs(argc > 2 ? std::max(atoi(argv[2]), 1) : 600);
+	if (mode == "generate")
+	{
+		if (argc != 12)
+		{
+			printf("usage: Benchmark generate <path> <width> <height> <wall density> <snakes> <frogs> <plants> <spits> <yetis> <mammoths>\n");
+			return 1;
+		}
+		StressParams params;
+		params.width = atoi(argv[3]);
+		params.height = atoi(argv[4]);
+		params.wallDensity = atof(argv[5]);
+		params.snakes = atoi(argv[6]);
+		params.frogs = atoi(argv[7]);
+		params.plants = atoi(argv[8]);
+		params.spits = atoi(argv[9]);
+		params.yetis = atoi(argv[10]);
+		params.mammoths = atoi(argv[11]);
+		if (params.width < 32 || params.height < 8)
+		{
+			printf("levels must be at least 32 wide and 8 high\n");
+			return 1;
+		}
+		if ((params.yetis || params.mammoths) && (params.snakes || params.frogs || params.plants || params.spits))
+			printf("yetis and mammoths need tileset 1, which has no snakes, frogs, plants or spits, so those are left out\n");
+		return writeStressLevel(argv[2], params, static_cast<unsigned int>(time(0))) ? 0 : 1;
+	}
+	if (!mode.empty())
+	{
+		printf("usage: Benchmark [stress [threads] | generate ... | replay ... | allocs [frames]]\n");
+		return 1;
+	}
+
+	// every sprite set gets enough null frames for any index the classes use
+	for (std::vector<SDL_Texture*> &imageSet : tileImages)
+		imageSet.assign(16, nullptr);
+	Spore::m_imageSet.assign(16, nullptr);
+	Snowball::m_imageSet.assign(16, nullptr);
+
+	benchCollided();
+	benchAlign();
+	benchGetIndex();
+	benchBatch();
+	benchRain();
+	benchLevel();
+	benchGroupInstance();
+	benchRegion();
+	benchSnapshot();
+	benchBallistics();
+	benchUpdate("Snake::update", TILE_SNAKE);
+	benchUpdate("Ptero::update", TILE_PTERO);
+	benchUpdate("Frog::update", TILE_FROG);
+	benchUpdate("Plant::update", TILE_PLANT);
+	benchUpdate("Spit::update", TILE_SPIT);
+	benchUpdate("Mushroom::update", TILE_MUSHROOM);
+	benchUpdate("Mammoth::update", TILE_MAMMOTH);
+	benchUpdate("Yeti::update", TILE_YETI);
+	benchUpdate("ThinIce::update", TILE_THINICE);
+	benchUpdate("Gem100::update", TILE_GEM100);
+	return 0;
+}
@@ -5,19 +5,42 @@
 #include <iostream>
 #include <fstream>
 #include <vector>  
+#include <algorithm>
+#include <set>
+#include <map>
 #include <string>
 #include <math.h>
-#include <typeinfo>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <chrono>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_SSE2
+#include <emmintrin.h>
+#endif
 
 // ------------------------------GLOBALS------------------------------
 
-const Uint8 *keys = SDL_GetKeyboardState(NULL);
+const Uint8 *keys = SDL_GetKeyboardState(NULL); // key states the player reads, pointed at g_input's when the game starts
 const double pi{ 3.141592653 };
 const int screenw{ 640 };
 const int screenh{ 416 }; // + 64 for HUD
+const SDL_Rect viewRect{ 0, 64, screenw, screenh }; // the part of the screen the level shows in, below the HUD
 const int viewRangeH{ 10 };
 const int viewRangeV{ 8 };
+const int chunkW{ 32 }; // width in columns of each streamed level chunk
+const int streamMargin{ 8 }; // columns kept resident beyond the activation window on either side
+bool g_chunkCompression{ true }; // keep evicted chunks in memory run-length encoded rather than rereading them from disk
 SDL_Texture *zoom;
 int g_format;
 int g_count{ 0 };
@@ -25,8 +48,17 @@ int g_lives{ 3 };
 int g_score{ 0 };
 int g_levelW;
 int g_levelH;
+bool g_invulnerable{ false }; // the player can't die, so a scripted run always reaches the end of a level
+void (*g_frameHook)(){ nullptr }; // if set, called at the end of every frame of play
 static std::vector<SDL_Texture*> backgrounds;
-static std::vector<SDL_Texture*> rain;
+float g_rainDensity{ 0.5f }; // fraction of the rain pool falling, changed in play with F5 and F6
+double g_hitchMs{ 0 }; // a frame of play taking longer than this writes the state it started from to hitch.snap, 0 for never
+#ifdef _DEBUG
+bool g_debugKeys{ true }; // F7 to F9 rewind play and go back to checkpoints. They undo deaths, so only debug builds have them
+#else
+bool g_debugKeys{ false };
+#endif
+int g_targetFps{ 60 }; // frame rate the frame pacer aims for
 
 
 
@@ -37,35 +69,1103 @@ static std::vector<SDL_Texture*> rain;
 
 class Player;
 class Object;
-class Wall;
-class Water;
-class Ice;
+class Level;
 
 
 
 
 
 
-// ------------------------------FUNCTIONS------------------------------
+// ------------------------------PROFILING------------------------------
 
-// returns the number of digits in a given number
-int getDigits(int n)
+// the phases of a frame of play that are timed separately
+enum Phase
 {
-	int c{ 0 };
-	for (int i{ 10 }; i >= 0; i--)
+	PHASE_EVENTS,
+	PHASE_SNAPSHOT,
+	PHASE_PROTECTED,
+	PHASE_REGION,
+	PHASE_PLAYER,
+	PHASE_PROXIMITY,
+	PHASE_BACKGROUND,
+	PHASE_NONSOLID,
+	PHASE_SOLID,
+	PHASE_WEATHER,
+	PHASE_HUD,
+	PHASE_PRESENT,
+	PHASE_COUNT
+};
+const char *phaseNames[PHASE_COUNT]{ "EVENTS", "SNAPSHOT", "PROTECTED", "REGION", "PLAYER", "PROXIMITY", "BACKGROUND", "NONSOLID", "SOLID", "WEATHER", "HUD", "PRESENT" };
+
+
+// the per frame counts kept alongside the phase timings
+enum Counter
+{
+	COUNTER_COLLIDED, // calls to collided()
+	COUNTER_ALIGN, // steps taken inside align()
+	COUNTER_INSTANCES, // active instances
+	COUNTER_HAZARDS, // active dynamic hazards
+	COUNTER_LATENCY, // milliseconds from the key press the frame handled to the frame being presented, 0 if it handled none
+	COUNTER_SNAPSHOT, // bytes the frame's snapshot took up in the history
+	COUNTER_DRAWN, // sprites and tiles drawn
+	COUNTER_CULLED, // sprites and tiles skipped as they were off screen
+	COUNTER_COUNT
+};
+const char *counterNames[COUNTER_COUNT]{ "COLLIDED", "ALIGN", "INSTANCES", "HAZARDS", "LATENCY", "SNAPSHOT", "DRAWN", "CULLED" };
+
+
+// collects how long each phase of every frame takes, keeping a rolling window for the overlay and optionally writing every frame
+// out to a csv file for offline analysis
+class Profiler
+{
+private:
+	static constexpr int m_window{ 120 }; // frames covered by the rolling statistics
+	Uint64 m_ticks[PHASE_COUNT]{};
+	static thread_local int t_counts[COUNTER_COUNT]; // counted on this thread since they were last gathered
+	std::atomic<int> m_counters[COUNTER_COUNT]{};
+	double m_history[PHASE_COUNT + 1][m_window]{}; // milliseconds spent in each phase, the last row being the whole frame
+	int m_lastCounters[COUNTER_COUNT]{};
+	int m_latency[m_window]{}; // input latency of the last key presses
+	int m_presses{ 0 };
+	int m_frames{ 0 };
+	Uint64 m_frameStart{ 0 };
+	std::ofstream m_csv;
+public:
+	bool m_overlay{ false };
+	void add(Phase phase, Uint64 ticks)
 	{
-		if (floor(n / pow(10, i)) != 0)
-			c++;
+		m_ticks[phase] += ticks;
 	}
-	if (c == 0)
-		c++;
-	return c;
-}
+	// counts are kept per thread so that instances updated on worker threads don't contend for them
+	void count(Counter counter, int n = 1)
+	{
+		t_counts[counter] += n;
+	}
+	// adds this thread's counts to the frame's, every thread that counts does this before the frame ends
+	void gather()
+	{
+		for (int i{ 0 }; i < COUNTER_COUNT; i++)
+			if (t_counts[i])
+			{
+				m_counters[i] += t_counts[i];
+				t_counts[i] = 0;
+			}
+	}
+	void set(Counter counter, int n)
+	{
+		m_counters[counter] = n;
+	}
+	// records the milliseconds a key press took to reach the screen
+	void latency(int ms)
+	{
+		m_latency[m_presses++ % m_window] = ms;
+		set(COUNTER_LATENCY, ms);
+	}
+	// gets the average and worst input latency over the last key presses in milliseconds
+	void latencyStats(double *avg, int *max)
+	{
+		int n{ std::min(m_presses, m_window) };
+		*avg = 0;
+		*max = 0;
+		for (int i{ 0 }; i < n; i++)
+		{
+			*avg += static_cast<double>(m_latency[i]) / n;
+			*max = std::max(*max, m_latency[i]);
+		}
+	}
+	// starts or stops writing a row per frame to profile.csv
+	void toggleCsv()
+	{
+		if (m_csv.is_open())
+		{
+			m_csv.close();
+			return;
+		}
+		m_csv.open("profile.csv");
+		m_csv << "frame";
+		for (const char *name : phaseNames)
+			m_csv << ',' << name;
+		m_csv << ",FRAME";
+		for (const char *name : counterNames)
+			m_csv << ',' << name;
+		m_csv << '\n';
+	}
+	bool recording() { return m_csv.is_open(); }
+	// stores this frame's timings and counters and clears them for the next frame
+	void endFrame()
+	{
+		gather();
+		Uint64 now{ SDL_GetPerformanceCounter() };
+		double toMs{ 1000.0 / SDL_GetPerformanceFrequency() };
+		int slot{ m_frames % m_window };
+		for (int i{ 0 }; i < PHASE_COUNT; i++)
+			m_history[i][slot] = m_ticks[i] * toMs;
+		m_history[PHASE_COUNT][slot] = m_frameStart ? (now - m_frameStart) * toMs : 0;
+		if (m_csv.is_open())
+		{
+			m_csv << m_frames;
+			for (int i{ 0 }; i <= PHASE_COUNT; i++)
+				m_csv << ',' << m_history[i][slot];
+			for (const std::atomic<int> &n : m_counters)
+				m_csv << ',' << n;
+			m_csv << '\n';
+		}
+		for (int i{ 0 }; i < COUNTER_COUNT; i++)
+			m_lastCounters[i] = m_counters[i];
+		std::fill(m_ticks, m_ticks + PHASE_COUNT, 0);
+		for (std::atomic<int> &n : m_counters)
+			n = 0;
+		m_frameStart = now;
+		m_frames++;
+	}
+	// gets the rolling min, average and 99th percentile of a phase in milliseconds (PHASE_COUNT gives the whole frame)
+	void stats(int phase, double *min, double *avg, double *p99)
+	{
+		int n{ std::min(m_frames, m_window) };
+		double sorted[m_window];
+		std::copy(m_history[phase], m_history[phase] + n, sorted);
+		std::sort(sorted, sorted + n);
+		*min = n ? sorted[0] : 0;
+		*avg = 0;
+		for (int i{ 0 }; i < n; i++)
+			*avg += sorted[i] / n;
+		*p99 = n ? sorted[static_cast<int>(ceil(n * 0.99)) - 1] : 0;
+	}
+	// the counters of the last finished frame
+	int counter(Counter counter) { return m_lastCounters[counter]; }
+	// the milliseconds a phase took in the last finished frame (PHASE_COUNT gives the whole frame)
+	double last(int phase) { return m_frames ? m_history[phase][(m_frames - 1) % m_window] : 0; }
+};
+thread_local int Profiler::t_counts[COUNTER_COUNT]{};
+static Profiler g_profiler;
+// the phase being timed, PHASE_COUNT outside of any. Jobs run on worker threads while the main thread is inside a phase, so
+// they read this too, which is how the benchmark's allocation hook puts every allocation against the phase it was made in
+static std::atomic<int> g_phase{ PHASE_COUNT };
+
+
+// times the scope it is declared in as part of a phase
+class ScopedTimer
+{
+private:
+	Phase m_phase;
+	int m_outer;
+	Uint64 m_start;
+public:
+	ScopedTimer(Phase phase) :
+		m_phase{ phase }, m_outer{ g_phase.exchange(phase, std::memory_order_relaxed) }, m_start{ SDL_GetPerformanceCounter() }
+	{}
+	~ScopedTimer()
+	{
+		g_profiler.add(m_phase, SDL_GetPerformanceCounter() - m_start);
+		g_phase.store(m_outer, std::memory_order_relaxed);
+	}
+};
+
+
+
+
+
+
+// ------------------------------PACING------------------------------
+
+// starts frames on a steady cadence of g_targetFps, in place of a flat delay after each frame whatever it took. Most of the wait is
+// slept and the rest spun, as SDL_Delay can overshoot by a millisecond or two. When presenting blocks on vsync the blocked time is
+// moved to before the frame instead, so the frame is built (and its input read) as late as it can be without missing the refresh.
+class FramePacer
+{
+private:
+	static constexpr int m_bins{ 40 }; // frame time histogram bins of a millisecond each, the last also counting longer frames
+	int m_histogram[m_bins]{};
+	Uint64 m_next{ 0 }; // performance counter when the next frame is due
+	Uint64 m_lastStart{ 0 };
+	Uint64 m_presented{ 0 }; // when the last present returned, which on vsync is just after a refresh
+	double m_spinMs{ 2.0 }; // how long before the deadline sleeping stops, grown whenever a sleep overshoots
+	double m_presentDelay{ 0.0 }; // milliseconds after the last present that the next frame starts, so presenting blocks as little as it can
+	double m_busyMs{ 0.0 }; // slowest recent time from a frame starting to it being presented, decaying
+	double m_refreshMs{ 0.0 }; // smoothed time between presents returning
+	double m_slackMs{ 0.0 }; // smoothed time a frame could have started later by, spent blocking or delayed
+public:
+	// waits for the next frame to be due
+	void wait()
+	{
+		Uint64 frequency{ SDL_GetPerformanceFrequency() };
+		Uint64 period{ frequency / g_targetFps };
+		Uint64 now{ SDL_GetPerformanceCounter() };
+		if (!m_next || now > m_next + period) // a whole frame behind, start afresh rather than rushing to catch up
+			m_next = now;
+		Uint64 due{ std::max(m_next, m_presented + static_cast<Uint64>(m_presentDelay * frequency / 1000)) };
+		if (now < due)
+		{
+			double waitMs{ (due - now) * 1000.0 / frequency };
+			if (waitMs > m_spinMs)
+			{
+				SDL_Delay(static_cast<Uint32>(waitMs - m_spinMs));
+				Uint64 woke{ SDL_GetPerformanceCounter() };
+				if (woke > due) // a one off stall shouldn't leave it spinning for long
+					m_spinMs = std::min(m_spinMs + (woke - due) * 1000.0 / frequency, 4.0);
+				else
+					m_spinMs = std::max(m_spinMs * 0.99, 1.0);
+			}
+			while (SDL_GetPerformanceCounter() < due)
+				std::this_thread::yield();
+		}
+		now = SDL_GetPerformanceCounter();
+		if (m_lastStart)
+			m_histogram[std::min(static_cast<int>((now - m_lastStart) * 1000 / frequency), m_bins - 1)]++;
+		m_lastStart = now;
+		m_next += period;
+	}
+	// presents a frame. While presents are held back by vsync, later frames start as late after a present as the slowest recent
+	// frame allows, with a couple of milliseconds to spare.
+	void present(SDL_Renderer *ren)
+	{
+		double toMs{ 1000.0 / SDL_GetPerformanceFrequency() };
+		Uint64 start{ SDL_GetPerformanceCounter() };
+		if (m_lastStart)
+			m_busyMs = std::max((start - m_lastStart) * toMs, m_busyMs * 0.99);
+		SDL_RenderPresent(ren);
+		Uint64 end{ SDL_GetPerformanceCounter() };
+		if (m_presented)
+			m_refreshMs += 0.1 * ((end - m_presented) * toMs - m_refreshMs);
+		m_slackMs += 0.1 * ((end - start) * toMs + m_presentDelay - m_slackMs);
+		m_presented = end;
+		const double spare{ 2.0 };
+		m_presentDelay = m_slackMs > spare ? std::min(std::max(m_refreshMs - m_busyMs - spare, 0.0), m_refreshMs) : 0.0;
+	}
+	// frames started so far by how many milliseconds after the last they started
+	const int* histogram() { return m_histogram; }
+	int bins() { return m_bins; }
+};
+static FramePacer g_pacer;
+
+
+
+
+
+
+// ------------------------------JOBS------------------------------
+
+// a fixed pool of worker threads that run the items of a parallel loop. Each worker has its own queue of item ranges, taking work from
+// the back of it and stealing from the front of the others' when it runs dry, so uneven items still keep every core busy.
+class JobSystem
+{
+private:
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<std::pair<int, int>> ranges; // [first, last) item indices
+	};
+	std::vector<std::thread> m_workers;
+	std::vector<std::unique_ptr<Queue>> m_queues; // one per worker, the last belonging to the thread that starts the loop
+	std::function<void(int)> m_job;
+	std::atomic<int> m_remaining{ 0 }; // items not yet finished
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	int m_generation{ 0 }; // bumped for every loop so sleeping workers know there is work
+	bool m_quit{ false };
+
+	// runs one range from queue self, or stolen from another queue, returning false if there was none
+	bool runOne(int self)
+	{
+		std::pair<int, int> range{ -1, -1 };
+		for (int i{ 0 }; i < m_queues.size() && range.first == -1; i++)
+		{
+			Queue &queue{ *m_queues[(self + i) % m_queues.size()] };
+			std::lock_guard<std::mutex> guard{ queue.lock };
+			if (queue.ranges.empty())
+				continue;
+			if (i == 0)
+			{
+				range = queue.ranges.back();
+				queue.ranges.pop_back();
+			}
+			else
+			{
+				range = queue.ranges.front();
+				queue.ranges.pop_front();
+			}
+		}
+		if (range.first == -1)
+			return false;
+		for (int item{ range.first }; item < range.second; item++)
+			m_job(item);
+		g_profiler.gather();
+		m_remaining -= range.second - range.first;
+		return true;
+	}
+	void work(int self)
+	{
+		int seen{ 0 };
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ m_lock };
+				m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+				if (m_quit)
+					return;
+				seen = m_generation;
+			}
+			while (m_remaining > 0)
+				if (!runOne(self))
+					std::this_thread::yield();
+		}
+	}
+public:
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> guard{ m_lock };
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (std::thread &worker : m_workers)
+			worker.join();
+	}
+	// starts the workers, the thread that runs the loops also takes part so threads - 1 are created
+	void start(int threads)
+	{
+		for (int i{ 0 }; i < std::max(threads, 1); i++)
+			m_queues.emplace_back(new Queue);
+		for (int i{ 0 }; i < threads - 1; i++)
+			m_workers.emplace_back(&JobSystem::work, this, i);
+	}
+	// the threads a loop is spread over, counting the caller
+	int threads() { return m_workers.size() + 1; }
+	// calls job(i) for each i in [0, count) in batches of grain items, returning once all are done. Items may run in any order and on
+	// any thread, so job must only touch state that belongs to item i.
+	void parallelFor(int count, int grain, const std::function<void(int)> &job)
+	{
+		if (m_workers.empty())
+		{
+			for (int i{ 0 }; i < count; i++)
+				job(i);
+			return;
+		}
+		m_job = job;
+		m_remaining = count;
+		// deal out contiguous runs of ranges so that each worker starts on neighbouring items
+		int ranges{ (count + grain - 1) / grain };
+		for (int r{ 0 }; r < ranges; r++)
+		{
+			Queue &queue{ *m_queues[r * m_queues.size() / ranges] };
+			std::lock_guard<std::mutex> guard{ queue.lock };
+			queue.ranges.push_back({ r * grain, std::min(count, (r + 1) * grain) });
+		}
+		{
+			std::lock_guard<std::mutex> guard{ m_lock };
+			m_generation++;
+		}
+		m_wake.notify_all();
+		while (m_remaining > 0)
+			if (!runOne(m_queues.size() - 1))
+				std::this_thread::yield();
+	}
+};
+static JobSystem g_jobs;
+const int parallelMin{ 64 }; // fewer instances than this are updated on the main thread, as waking the workers would cost more
+const int parallelGrain{ 8 }; // instances per stealable batch
+
+
+
+
+
+
+// ------------------------------INPUT------------------------------
+
+// keyboard events queued with their timestamps as they are polled and handed to the game a tick at a time. Sampling the keyboard
+// once a frame misses a key pressed and released between two samples. Here each tick applies the queued presses and releases in
+// order, stopping before a second change to any key, which is left for the next tick, so the game sees every edge.
+class InputBuffer
+{
+private:
+	struct Edge
+	{
+		SDL_Scancode key;
+		bool down;
+		Uint32 time; // SDL ticks when the event was queued
+	};
+	std::vector<Edge> m_edges; // polled but not yet applied, oldest first
+	Uint8 m_keys[SDL_NUM_SCANCODES]{}; // the state the game sees this tick
+	bool m_changed[SDL_NUM_SCANCODES]{};
+	Uint32 m_pressTime{ 0 }; // when the first press applied this tick was queued, 0 if there was none
+public:
+	// queues a key event, other events are ignored
+	void handle(const SDL_Event &e)
+	{
+		if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !e.key.repeat)
+			m_edges.push_back({ e.key.keysym.scancode, e.type == SDL_KEYDOWN, e.key.timestamp });
+	}
+	// applies the queued edges for the coming tick
+	void tick()
+	{
+		std::fill(m_changed, m_changed + SDL_NUM_SCANCODES, false);
+		m_pressTime = 0;
+		int applied{ 0 };
+		for (; applied < m_edges.size(); applied++)
+		{
+			Edge &edge{ m_edges[applied] };
+			if (m_changed[edge.key])
+				break;
+			m_keys[edge.key] = edge.down;
+			m_changed[edge.key] = true;
+			if (edge.down && !m_pressTime)
+				m_pressTime = edge.time;
+		}
+		m_edges.erase(m_edges.begin(), m_edges.begin() + applied);
+	}
+	// the key states for this tick, indexed by scancode like SDL_GetKeyboardState
+	const Uint8* keys() { return m_keys; }
+	// called once the frame built from this tick is presented, reporting how long its key press took to reach the screen
+	void presented()
+	{
+		if (m_pressTime)
+			g_profiler.latency(SDL_GetTicks() - m_pressTime);
+		m_pressTime = 0;
+	}
+};
+static InputBuffer g_input;
+
+
+
+
+
+
+// ------------------------------AUDIO------------------------------
+
+// sound commands from the game, carried out on an audio thread so that the game never waits on the mixer. Every Mix_ call takes the
+// audio device lock, which the mixer holds while it fills each buffer. Commands pass through a fixed ring that only the game thread
+// writes and only the audio thread reads, so neither side locks. Until start() is called (it isn't if audio couldn't be opened)
+// commands are dropped, so headless runs are silent without any extra setup.
+class AudioQueue
+{
+private:
+	enum Op { PLAY, FADE_OUT, HALT, PLAY_MUSIC, HALT_MUSIC };
+	struct Command
+	{
+		Op op;
+		int channel;
+		Mix_Chunk *chunk;
+		Mix_Music *music;
+		int value; // loops for chunks, volume for music
+		int ms;
+	};
+	static constexpr unsigned int m_capacity{ 256 }; // far more than are posted between two drains
+	Command m_ring[m_capacity];
+	std::atomic<unsigned int> m_head{ 0 }; // next slot to write, moved only by the game thread
+	std::atomic<unsigned int> m_tail{ 0 }; // next slot to read, moved only by the audio thread
+	std::vector<Mix_Chunk*> m_started; // chunks started this tick
+	std::thread m_worker;
+	std::atomic<bool> m_running{ false };
+	std::mutex m_lock; // only for the audio thread to sleep on, posting never takes it
+	std::condition_variable m_wake;
+
+	void post(const Command &command)
+	{
+		if (!m_running)
+			return;
+		unsigned int head{ m_head.load(std::memory_order_relaxed) };
+		if (head - m_tail.load(std::memory_order_acquire) == m_capacity) // full, drop the sound rather than wait
+			return;
+		m_ring[head % m_capacity] = command;
+		m_head.store(head + 1, std::memory_order_release);
+		m_wake.notify_one();
+	}
+	void run(const Command &command)
+	{
+		switch (command.op)
+		{
+		case PLAY:
+			Mix_PlayChannel(command.channel, command.chunk, command.value);
+			break;
+		case FADE_OUT:
+			if (Mix_Playing(command.channel))
+				Mix_FadeOutChannel(command.channel, command.ms);
+			break;
+		case HALT:
+			Mix_HaltChannel(command.channel);
+			break;
+		case PLAY_MUSIC:
+			Mix_HaltMusic();
+			Mix_VolumeMusic(command.value);
+			Mix_FadeInMusic(command.music, -1, command.ms);
+			break;
+		case HALT_MUSIC:
+			Mix_HaltMusic();
+			break;
+		}
+	}
+	void work()
+	{
+		while (true)
+		{
+			unsigned int tail{ m_tail.load(std::memory_order_relaxed) };
+			if (tail == m_head.load(std::memory_order_acquire))
+			{
+				if (!m_running)
+					return;
+				// a wake up missed between the check and the wait only costs the timeout
+				std::unique_lock<std::mutex> lock{ m_lock };
+				m_wake.wait_for(lock, std::chrono::milliseconds(2));
+				continue;
+			}
+			run(m_ring[tail % m_capacity]);
+			m_tail.store(tail + 1, std::memory_order_release);
+		}
+	}
+public:
+	~AudioQueue()
+	{
+		stop();
+	}
+	void start()
+	{
+		m_running = true;
+		m_worker = std::thread{ &AudioQueue::work, this };
+	}
+	// carries out what has been posted and stops the audio thread, after which sounds and music can be freed
+	void stop()
+	{
+		if (!m_worker.joinable())
+			return;
+		m_running = false;
+		m_wake.notify_one();
+		m_worker.join();
+	}
+	// ends a tick. A chunk started several times in one tick (say three gems picked up at once) is only played the first time.
+	void tick()
+	{
+		m_started.clear();
+	}
+	void play(int channel, Mix_Chunk *chunk, int loops = 0)
+	{
+		if (!m_running)
+			return;
+		if (std::find(m_started.begin(), m_started.end(), chunk) != m_started.end())
+			return;
+		m_started.push_back(chunk);
+		post({ PLAY, channel, chunk, nullptr, loops, 0 });
+	}
+	// fades a channel out if it is still playing
+	void fadeOut(int channel, int ms)
+	{
+		post({ FADE_OUT, channel, nullptr, nullptr, 0, ms });
+	}
+	void halt(int channel)
+	{
+		post({ HALT, channel, nullptr, nullptr, 0, 0 });
+	}
+	// starts a piece of music looping in place of whatever was playing. There is a single music volume, so it is set for each piece.
+	void playMusic(Mix_Music *music, int volume, int fadeMs = 0)
+	{
+		post({ PLAY_MUSIC, -1, nullptr, music, volume, fadeMs });
+	}
+	void haltMusic()
+	{
+		post({ HALT_MUSIC, -1, nullptr, nullptr, 0, 0 });
+	}
+};
+static AudioQueue g_audio;
+
+
+
+
+
+
+// ------------------------------SNAPSHOTS------------------------------
+
+// the state of the world packed into bytes. Saving and loading are the same walk over the world: everything passes its fields through
+// sync() in a fixed order, which appends them while saving and reads them back in that order while loading.
+class Snapshot
+{
+private:
+	std::vector<Uint8> m_bytes;
+	int m_read{ -1 }; // read position while loading, -1 while saving
+public:
+	// empties the snapshot to be saved into
+	void beginSave()
+	{
+		m_bytes.clear();
+		m_read = -1;
+	}
+	void beginLoad()
+	{
+		m_read = 0;
+	}
+	bool loading() { return m_read >= 0; }
+	// whether a load read exactly what was saved, no less and no more
+	bool complete() { return m_read == m_bytes.size(); }
+	bool empty() { return m_bytes.empty(); }
+	std::vector<Uint8>& bytes() { return m_bytes; }
+	// appends a field while saving, or overwrites it with the next one while loading
+	template <typename T>
+	void sync(T &value)
+	{
+		if (m_read < 0)
+		{
+			const Uint8 *field{ reinterpret_cast<const Uint8*>(&value) };
+			m_bytes.insert(m_bytes.end(), field, field + sizeof(T));
+			return;
+		}
+		if (m_read + sizeof(T) <= m_bytes.size())
+			memcpy(&value, &m_bytes[m_read], sizeof(T));
+		m_read += sizeof(T);
+	}
+	// syncs the length of a list and returns it. A length read back is held to the bytes left, so that a snapshot of something else
+	// can't ask for more than it holds.
+	int syncCount(int count)
+	{
+		sync(count);
+		if (m_read >= 0)
+			count = std::min(std::max(count, 0), static_cast<int>(m_bytes.size()) - std::min(m_read, static_cast<int>(m_bytes.size())));
+		return count;
+	}
+	// stops a load, leaving it incomplete
+	void fail()
+	{
+		m_read = m_bytes.size() + 1;
+	}
+	bool write(const std::string &path)
+	{
+		std::ofstream file{ path, std::ios::binary };
+		file.write(reinterpret_cast<const char*>(m_bytes.data()), m_bytes.size());
+		return file.good();
+	}
+	bool read(const std::string &path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file.is_open())
+			return false;
+		m_bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		m_read = -1;
+		return true;
+	}
+};
+
+
+// the last ten seconds of snapshots, one a tick. Every 60th is kept whole and the rest only as the bytes that differ from the one
+// before, which from one tick to the next is a few positions and timers. Every slot is given room for a whole snapshot on the first
+// record, so recording doesn't allocate after that unless the world grows past twice the size it started at.
+class SnapshotRing
+{
+private:
+	static constexpr int m_capacity{ 600 };
+	static constexpr int m_keyInterval{ 60 };
+	std::vector<Uint8> m_entries[m_capacity];
+	bool m_key[m_capacity]{}; // whether the entry is a whole snapshot rather than a delta
+	std::vector<Uint8> m_last; // the newest snapshot whole, which the next is diffed against
+	size_t m_reserved{ 0 }; // bytes every slot has room for
+	int m_head{ 0 }; // the slot the next snapshot goes in
+	int m_count{ 0 };
+	int m_sinceKey{ 0 };
+	static void putCount(std::vector<Uint8> &out, int n) // 7 bits a byte, low bits first
+	{
+		for (; n >= 128; n >>= 7)
+			out.push_back((n & 127) | 128);
+		out.push_back(n);
+	}
+	static int getCount(const std::vector<Uint8> &in, int &i)
+	{
+		int n{ 0 };
+		for (int shift{ 0 }; i < in.size(); shift += 7)
+		{
+			Uint8 byte{ in[i++] };
+			n |= (byte & 127) << shift;
+			if (!(byte & 128))
+				break;
+		}
+		return n;
+	}
+	// writes next as its size and then runs of (unchanged count, changed count, changed bytes xored with the old ones) against m_last,
+	// bytes past the end of m_last counting as zero. Gives up, returning false, if that would come to more than next itself.
+	bool encode(const std::vector<Uint8> &next, std::vector<Uint8> &out)
+	{
+		auto changed = [&](int i) { return next[i] != (i < m_last.size() ? m_last[i] : 0); };
+		int n{ static_cast<int>(next.size()) };
+		out.clear();
+		putCount(out, n);
+		for (int i{ 0 }; i < n;)
+		{
+			int start{ i };
+			while (start < n && !changed(start))
+				start++;
+			if (start == n)
+				break;
+			// a changed run carries on over gaps of a couple of unchanged bytes, as ending it there would cost as much
+			int end{ start + 1 };
+			while (end < n && (changed(end) || (end + 1 < n && changed(end + 1)) || (end + 2 < n && changed(end + 2))))
+				end++;
+			putCount(out, start - i);
+			putCount(out, end - start);
+			if (out.size() + end - start >= n)
+				return false;
+			for (int j{ start }; j < end; j++)
+				out.push_back(next[j] ^ (j < m_last.size() ? m_last[j] : 0));
+			i = end;
+		}
+		return true;
+	}
+	// makes room in every slot for twice a snapshot of size bytes. A delta stops just past the size of the snapshot it is of, so that
+	// covers those too.
+	void reserve(size_t size)
+	{
+		if (size <= m_reserved)
+			return;
+		m_reserved = size * 2;
+		for (std::vector<Uint8> &entry : m_entries)
+			entry.reserve(m_reserved);
+		m_last.reserve(m_reserved);
+	}
+	// turns the snapshot before a delta into the one it was taken against
+	static void decode(const std::vector<Uint8> &in, std::vector<Uint8> &state)
+	{
+		int i{ 0 };
+		state.resize(getCount(in, i), 0);
+		int at{ 0 };
+		while (i < in.size())
+		{
+			at += getCount(in, i);
+			for (int n{ getCount(in, i) }; n > 0; n--)
+				state[at++] ^= in[i++];
+		}
+	}
+public:
+	void clear()
+	{
+		m_head = 0;
+		m_count = 0;
+		m_sinceKey = 0;
+		m_last.clear();
+	}
+	void record(const std::vector<Uint8> &state)
+	{
+		reserve(state.size());
+		m_key[m_head] = m_count == 0 || m_sinceKey >= m_keyInterval || !encode(state, m_entries[m_head]); // a delta no smaller is kept whole
+		if (m_key[m_head])
+		{
+			m_entries[m_head] = state;
+			m_sinceKey = 0;
+		}
+		m_sinceKey++;
+		m_last = state;
+		m_head = (m_head + 1) % m_capacity;
+		m_count = std::min(m_count + 1, m_capacity);
+	}
+	// rebuilds the snapshot recorded back ticks before the newest into out and forgets those after it, so recording carries on from
+	// there. Goes back as far as it can if that is older than anything held, returning false only if nothing has been recorded.
+	bool rewind(int back, Snapshot &out)
+	{
+		if (m_count == 0)
+			return false;
+		auto slot = [&](int b) { return (m_head - 1 - b + m_capacity) % m_capacity; };
+		back = std::min(std::max(back, 0), m_count - 1);
+		int key{ back }; // the whole snapshot the target's deltas start from
+		while (key < m_count && !m_key[slot(key)])
+			key++;
+		if (key == m_count) // overwritten as the ring went round, so go back to the oldest whole snapshot instead
+		{
+			for (key = back; !m_key[slot(key)]; key--)
+				;
+			back = key;
+		}
+		std::vector<Uint8> &state{ out.bytes() };
+		state = m_entries[slot(key)];
+		for (int b{ key - 1 }; b >= back; b--)
+			decode(m_entries[slot(b)], state);
+		m_last = state;
+		m_head = (slot(back) + 1) % m_capacity;
+		m_count -= back;
+		m_sinceKey = key - back + 1;
+		return true;
+	}
+	// the bytes the newest entry takes up
+	int lastSize() { return m_count ? m_entries[(m_head - 1 + m_capacity) % m_capacity].size() : 0; }
+};
+
+
+
+
+
+
+// ------------------------------RESOURCES------------------------------
+
+// what kind of thing a resource is, which is also where its memory lives
+enum ResourceKind
+{
+	RESOURCE_TEXTURE, // video memory
+	RESOURCE_SURFACE, // system memory
+	RESOURCE_CHUNK, // decoded sound, system memory
+	RESOURCE_KIND_COUNT
+};
+const char *resourceKindNames[RESOURCE_KIND_COUNT]{ "texture", "surface", "chunk" };
+
+
+// every texture, surface and sound chunk the game holds, with what owns it and roughly how much memory it takes. Anything made
+// through here is released through here too, so what is live can be reported at any time, and anything made during a level and
+// still live when it ends is flagged as a leak. Used from the main thread only, as the renderer is.
+class Resources
+{
+private:
+	struct Entry
+	{
+		ResourceKind kind;
+		const char *owner; // the subsystem it belongs to
+		std::string name;
+		size_t bytes;
+		int serial; // order of creation
+	};
+	std::map<void*, Entry> m_live;
+	size_t m_bytes[RESOURCE_KIND_COUNT]{};
+	int m_serial{ 0 };
+	int m_levelStart{ 0 }; // serial of the first resource made since the level started
+	std::string m_logPath{ "resources.log" };
+	void add(void *ptr, ResourceKind kind, const char *owner, const std::string &name, size_t bytes)
+	{
+		if (!ptr)
+			return;
+		m_live[ptr] = { kind, owner, name, bytes, m_serial++ };
+		m_bytes[kind] += bytes;
+	}
+	// forgets a resource, returning false if it wasn't made through here
+	bool remove(void *ptr)
+	{
+		auto entry{ m_live.find(ptr) };
+		if (entry == m_live.end())
+			return false;
+		m_bytes[entry->second.kind] -= entry->second.bytes;
+		m_live.erase(entry);
+		return true;
+	}
+public:
+	// takes ownership of a texture, estimating its size from its dimensions and format
+	SDL_Texture* track(SDL_Texture *texture, const char *owner, const std::string &name)
+	{
+		Uint32 format{ 0 };
+		int w{ 0 };
+		int h{ 0 };
+		if (texture)
+			SDL_QueryTexture(texture, &format, NULL, &w, &h);
+		add(texture, RESOURCE_TEXTURE, owner, name, static_cast<size_t>(w) * h * SDL_BYTESPERPIXEL(format));
+		return texture;
+	}
+	SDL_Surface* track(SDL_Surface *surface, const char *owner, const std::string &name)
+	{
+		add(surface, RESOURCE_SURFACE, owner, name, surface ? static_cast<size_t>(surface->pitch) * surface->h : 0);
+		return surface;
+	}
+	Mix_Chunk* track(Mix_Chunk *chunk, const char *owner, const std::string &name)
+	{
+		add(chunk, RESOURCE_CHUNK, owner, name, chunk ? chunk->alen : 0);
+		return chunk;
+	}
+	// loads an image straight into a texture, freeing the surface it was decoded into
+	SDL_Texture* texture(SDL_Renderer *ren, const std::string &path, const char *owner)
+	{
+		SDL_Surface *surface{ IMG_Load(path.c_str()) };
+		SDL_Texture *texture{ surface ? SDL_CreateTextureFromSurface(ren, surface) : nullptr };
+		if (surface)
+			SDL_FreeSurface(surface);
+		return track(texture, owner, path);
+	}
+	SDL_Surface* surface(const std::string &path, const char *owner)
+	{
+		return track(IMG_Load(path.c_str()), owner, path);
+	}
+	Mix_Chunk* sound(const std::string &path, const char *owner)
+	{
+		return track(Mix_LoadWAV(path.c_str()), owner, path);
+	}
+	void destroy(SDL_Texture *texture)
+	{
+		if (texture)
+		{
+			remove(texture);
+			SDL_DestroyTexture(texture);
+		}
+	}
+	void destroy(SDL_Surface *surface)
+	{
+		if (surface)
+		{
+			remove(surface);
+			SDL_FreeSurface(surface);
+		}
+	}
+	void destroy(Mix_Chunk *chunk)
+	{
+		if (chunk)
+		{
+			remove(chunk);
+			Mix_FreeChunk(chunk);
+		}
+	}
+	// releases everything still live, before the renderer and the mixer are closed
+	void destroyAll()
+	{
+		while (!m_live.empty())
+		{
+			void *ptr{ m_live.begin()->first };
+			ResourceKind kind{ m_live.begin()->second.kind };
+			remove(ptr);
+			if (kind == RESOURCE_TEXTURE)
+				SDL_DestroyTexture(static_cast<SDL_Texture*>(ptr));
+			else if (kind == RESOURCE_SURFACE)
+				SDL_FreeSurface(static_cast<SDL_Surface*>(ptr));
+			else
+				Mix_FreeChunk(static_cast<Mix_Chunk*>(ptr));
+		}
+	}
+	// estimated bytes held in resources of a kind
+	size_t bytes(ResourceKind kind) { return m_bytes[kind]; }
+	int live() { return m_live.size(); }
+	// appends the live resources to the log, totalled by owner and kind
+	void report()
+	{
+		std::map<std::string, std::pair<int, size_t>> totals;
+		for (auto &entry : m_live)
+		{
+			std::pair<int, size_t> &total{ totals[std::string{ entry.second.owner } + ' ' + resourceKindNames[entry.second.kind]] };
+			total.first++;
+			total.second += entry.second.bytes;
+		}
+		std::ofstream log{ m_logPath, std::ios::app };
+		log << "live resources at frame " << g_count << '\n';
+		for (auto &total : totals)
+			log << "  " << total.first << ": " << total.second.first << ", " << total.second.second / 1024 << " KB\n";
+		for (int i{ 0 }; i < RESOURCE_KIND_COUNT; i++)
+			log << "  all " << resourceKindNames[i] << "s: " << m_bytes[i] / 1024 << " KB\n";
+	}
+	void beginLevel()
+	{
+		m_levelStart = m_serial;
+	}
+	// logs every resource made since the level began that is still live, returning how many there are
+	int endLevel(int levelNum)
+	{
+		int leaks{ 0 };
+		std::ofstream log;
+		for (auto &entry : m_live)
+			if (entry.second.serial >= m_levelStart)
+			{
+				if (!log.is_open())
+					log.open(m_logPath, std::ios::app);
+				log << "level " << levelNum << " leaked " << entry.second.owner << ' ' << resourceKindNames[entry.second.kind] << ' '
+					<< entry.second.name << ", " << entry.second.bytes << " bytes\n";
+				leaks++;
+			}
+		m_levelStart = m_serial;
+		return leaks;
+	}
+};
+static Resources g_resources;
 
 
+
+
+
+
+// ------------------------------BALLISTICS------------------------------
+
+// how a shot should be launched to land on a target, and whether it can
+struct Aim
+{
+	float hspd;
+	float vspd;
+	bool reachable; // false if the target is beyond the launch speed's reach, the speeds are then meaningless
+};
+
+
+// aims shots fired at launchSpeed under launchGravity (the spores of spits, and the frog's jump) along the high arc onto a target.
+// The arc only depends on how far to the side and how far up the target is, so its launch velocity is worked out once for a grid of
+// those on startup and interpolated between, leaving no trigonometry or square roots to each shot. Reach is decided exactly.
+class Ballistics
+{
+private:
+	static constexpr double m_speed{ 10 };
+	static constexpr double m_gravity{ 0.3 };
+	static constexpr int m_step{ 8 }; // pixels between samples
+	static constexpr int m_maxX{ 672 }; // furthest to the side sampled, past the most any height gives
+	static constexpr int m_minY{ -480 };
+	static constexpr int m_maxY{ 480 };
+	static constexpr int m_cols{ m_maxX / m_step + 1 };
+	static constexpr int m_rows{ (m_maxY - m_minY) / m_step + 1 };
+	float m_table[m_rows][m_cols][2]; // horizontal and vertical launch speed for each (height, distance) sample
+	// the launch angle above the horizontal onto a target x to the side and y up, or at the edge of reach if it is out of it
+	static double angle(double x, double y)
+	{
+		double d{ std::max(0.0, discriminant(x, y)) };
+		return atan2(m_speed * m_speed + sqrt(d), m_gravity * x);
+	}
+	static double discriminant(double x, double y)
+	{
+		return m_speed * m_speed * m_speed * m_speed - m_gravity * (m_gravity * x * x + 2 * y * m_speed * m_speed);
+	}
+public:
+	Ballistics()
+	{
+		for (int r{ 0 }; r < m_rows; r++)
+			for (int c{ 0 }; c < m_cols; c++)
+			{
+				double dir{ angle(c * m_step, m_minY + r * m_step) };
+				m_table[r][c][0] = m_speed * cos(dir);
+				m_table[r][c][1] = m_speed * sin(dir);
+			}
+	}
+	// aims a shot from (x, y) at a target at (targetx, targety)
+	Aim aim(double x, double y, double targetx, double targety) const
+	{
+		double dx{ targetx - x };
+		double up{ y - targety };
+		double side{ fabs(dx) };
+		Aim result;
+		result.reachable = discriminant(side, up) >= 0;
+		if (!result.reachable)
+			return result;
+		float speed[2];
+		if (side < m_maxX && up >= m_minY && up < m_maxY)
+		{
+			double fc{ side / m_step };
+			double fr{ (up - m_minY) / m_step };
+			int c{ static_cast<int>(fc) };
+			int r{ static_cast<int>(fr) };
+			float tc{ static_cast<float>(fc - c) };
+			float tr{ static_cast<float>(fr - r) };
+			for (int i{ 0 }; i < 2; i++)
+			{
+				float low{ m_table[r][c][i] + (m_table[r][c + 1][i] - m_table[r][c][i]) * tc };
+				float high{ m_table[r + 1][c][i] + (m_table[r + 1][c + 1][i] - m_table[r + 1][c][i]) * tc };
+				speed[i] = low + (high - low) * tr;
+			}
+		}
+		else // off the table, which only far below can be while still in reach
+		{
+			double dir{ angle(side, up) };
+			speed[0] = m_speed * cos(dir);
+			speed[1] = m_speed * sin(dir);
+		}
+		result.hspd = dx < 0 ? -speed[0] : speed[0];
+		result.vspd = -speed[1];
+		return result;
+	}
+	// aims n shots at once, shot i going from (x[i], y[i]) to (targetx[i], targety[i])
+	void aim(int n, const double *x, const double *y, const double *targetx, const double *targety, Aim *out) const
+	{
+		for (int i{ 0 }; i < n; i++)
+			out[i] = aim(x[i], y[i], targetx[i], targety[i]);
+	}
+};
+static const Ballistics g_ballistics;
+
+
+
+
+
+
+// ------------------------------FUNCTIONS------------------------------
+
 // takes 2 rects and returns true if they overlap, false otherwise (checks at intervals of 8 pixels)
 bool collided(SDL_Rect &left, SDL_Rect &right)
 {
+	g_profiler.count(COUNTER_COLLIDED);
 	for (int h{ 0 }; h <= left.w; h += 8)
 	{
 		for (int v{ 0 }; v <= left.h; v += 8)
@@ -85,6 +1185,7 @@ bool align(SDL_Rect &left, SDL_Rect &right, int xstep, int ystep)
 	bool rvalue{ false };
 	while (collided(left, right))
 	{
+		g_profiler.count(COUNTER_ALIGN);
 		left = { left.x - xstep, left.y - ystep, left.w, left.h };
 		rvalue = true;
 	}
@@ -105,40 +1206,305 @@ int getIndex(std::vector<T> *vector, T &term)
 }
 
 
-// draws the given string to a texture 
-void stringTexture(TTF_Font *font, std::string &string, SDL_Texture *text)
+// the side effects of one instance's update while instances are updated in parallel. They are applied afterwards in instance order,
+// which gives the same draw order and the same hazards group as updating the instances one after another.
+struct Deferred
 {
-	SDL_Surface *scoreSurface = SDL_ConvertSurfaceFormat(TTF_RenderText_Shaded(font, string.c_str(), { 255, 255, 255 }, { 0, 0, 0 }), g_format, 0);
-	SDL_UpdateTexture(text, NULL, scoreSurface->pixels, scoreSurface->pitch);
-	SDL_FreeSurface(scoreSurface);
+	struct Sprite
+	{
+		SDL_Texture *texture;
+		SDL_Rect rect;
+		SDL_RendererFlip flip;
+	};
+	std::vector<Sprite> sprites;
+	std::vector<std::pair<Object*, bool>> hazards; // objects added to (true) or removed from (false) the hazards group, in order
+	bool terrainChanged{ false }; // a dynamic tile changed whether walkers can cross it
+	// carries out the recorded side effects, returning whether the terrain changed so the caller can tell the level
+	bool apply(SDL_Renderer *ren, std::vector<Object*> *hazardGroup)
+	{
+		for (Sprite &sprite : sprites)
+			SDL_RenderCopyEx(ren, sprite.texture, NULL, &sprite.rect, 0, NULL, sprite.flip);
+		for (std::pair<Object*, bool> &op : hazards)
+		{
+			if (op.second)
+				hazardGroup->push_back(op.first);
+			else
+				hazardGroup->erase(hazardGroup->begin() + getIndex(hazardGroup, op.first));
+		}
+		sprites.clear();
+		hazards.clear();
+		bool changed{ terrainChanged };
+		terrainChanged = false;
+		return changed;
+	}
+};
+static thread_local Deferred *t_deferred{ nullptr }; // where this thread's side effects go, nullptr to apply them straight away
+
+
+// whether a rect in screen coordinates shows any of the level. Objects are updated across the whole activation window, which is
+// wider and taller than the screen, so anything outside this is left undrawn while still being simulated.
+bool visible(const SDL_Rect &rect)
+{
+	bool shown{ rect.x < viewRect.x + viewRect.w && rect.x + rect.w > viewRect.x && rect.y < viewRect.y + viewRect.h && rect.y + rect.h > viewRect.y };
+	g_profiler.count(shown ? COUNTER_DRAWN : COUNTER_CULLED);
+	return shown;
 }
 
 
-// load the level file into the correct format
-void loadLevel(std::vector<std::vector<int>>* level, int* tileSet, bool* weather, int* track, std::string path)
+// draws an object's sprite if it is on screen, or records it for later if the object is being updated in parallel
+void drawSprite(SDL_Renderer *ren, SDL_Texture *texture, const SDL_Rect &rect, SDL_RendererFlip flip = SDL_FLIP_NONE)
 {
-	level->clear(); // empty level vector
-	std::ifstream levelInput(path); // open the file
-	std::string line;
-	if (levelInput.is_open()) // if file opened correctly
+	if (!visible(rect))
+		return;
+	if (t_deferred)
+		t_deferred->sprites.push_back({ texture, rect, flip });
+	else
+		SDL_RenderCopyEx(ren, texture, NULL, &rect, 0, NULL, flip);
+}
+
+
+// whether an object is in the hazards group, counting this thread's own deferred changes to it
+bool isHazard(std::vector<Object*> *hazards, Object *ptr)
+{
+	if (t_deferred)
+		for (int i{ static_cast<int>(t_deferred->hazards.size()) - 1 }; i >= 0; i--)
+			if (t_deferred->hazards[i].first == ptr)
+				return t_deferred->hazards[i].second;
+	return getIndex(hazards, ptr) != -1;
+}
+
+
+// objects only ever add or remove themselves (or their projectiles) from the hazards group, through these two
+void addHazard(std::vector<Object*> *hazards, Object *ptr)
+{
+	if (t_deferred)
+		t_deferred->hazards.push_back({ ptr, true });
+	else
+		hazards->push_back(ptr);
+}
+void removeHazard(std::vector<Object*> *hazards, Object *ptr)
+{
+	if (t_deferred)
+		t_deferred->hazards.push_back({ ptr, false });
+	else
+		hazards->erase(hazards->begin() + getIndex(hazards, ptr));
+}
+
+
+// a batch of rects stored one array per field, so that the kernels below can test several against the player at once
+struct RectBatch
+{
+	std::vector<int> x;
+	std::vector<int> y;
+	std::vector<int> w;
+	std::vector<int> h;
+	void clear()
 	{
-		int whileCount{ 0 };
-		std::getline(levelInput, line);
-		*weather = static_cast<int>(line.at(0) - 48); // read weather effect
-		*track = static_cast<int>(line.at(1) - 48); // read music track
-		*tileSet = static_cast<int>(line.at(2) - 48); // read tileset used
-		while (std::getline(levelInput, line)) // take the next line and store it in string
-		{
-			level->push_back({}); // add an empty vector
-			for (char c : line) // push the ascii integer value of each character to new vector
-				level->at(whileCount).push_back(static_cast<int>(c - 97));
-			whileCount++;
-		}
+		x.clear();
+		y.clear();
+		w.clear();
+		h.clear();
+	}
+	void push(const SDL_Rect &rect)
+	{
+		x.push_back(rect.x);
+		y.push_back(rect.y);
+		w.push_back(rect.w);
+		h.push_back(rect.h);
 	}
-	levelInput.close(); // close the file
+	int size() const { return x.size(); }
+};
+
+
+// whether collided() would find one of left's sample points inside right along one axis. The first sample past right's near edge
+// (rounded up to the 8 pixel lattice) has to exist within left and fall short of right's far edge.
+inline bool overlapAxis(int lpos, int llen, int rpos, int rlen)
+{
+	int first{ (std::max(rpos - lpos + 1, 0) + 7) & ~7 };
+	return first <= llen && lpos + first < rpos + rlen;
 }
 
 
+// sets hits[i] to whether collided(rect, batch rect i) is true, giving exactly the same answer eight (AVX2) or four (SSE2) rects at a time
+void overlapKernel(const SDL_Rect &rect, const RectBatch &batch, std::vector<Uint8> &hits)
+{
+	int n{ batch.size() };
+	hits.resize(n);
+	int i{ 0 };
+#if defined(__AVX2__)
+	const __m256i zero{ _mm256_setzero_si256() };
+	const __m256i seven{ _mm256_set1_epi32(7) };
+	const __m256i lattice{ _mm256_set1_epi32(~7) };
+	const __m256i lx{ _mm256_set1_epi32(rect.x) };
+	const __m256i ly{ _mm256_set1_epi32(rect.y) };
+	const __m256i lx1{ _mm256_set1_epi32(rect.x - 1) };
+	const __m256i ly1{ _mm256_set1_epi32(rect.y - 1) };
+	const __m256i lw{ _mm256_set1_epi32(rect.w) };
+	const __m256i lh{ _mm256_set1_epi32(rect.h) };
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i rx{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.x[i])) };
+		__m256i ry{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.y[i])) };
+		__m256i rw{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.w[i])) };
+		__m256i rh{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.h[i])) };
+		__m256i fx{ _mm256_and_si256(_mm256_add_epi32(_mm256_max_epi32(_mm256_sub_epi32(rx, lx1), zero), seven), lattice) };
+		__m256i fy{ _mm256_and_si256(_mm256_add_epi32(_mm256_max_epi32(_mm256_sub_epi32(ry, ly1), zero), seven), lattice) };
+		__m256i hitx{ _mm256_andnot_si256(_mm256_cmpgt_epi32(fx, lw), _mm256_cmpgt_epi32(_mm256_add_epi32(rx, rw), _mm256_add_epi32(lx, fx))) };
+		__m256i hity{ _mm256_andnot_si256(_mm256_cmpgt_epi32(fy, lh), _mm256_cmpgt_epi32(_mm256_add_epi32(ry, rh), _mm256_add_epi32(ly, fy))) };
+		int mask{ _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(hitx, hity))) };
+		for (int k{ 0 }; k < 8; k++)
+			hits[i + k] = (mask >> k) & 1;
+	}
+#elif defined(BATCH_SSE2)
+	const __m128i zero{ _mm_setzero_si128() };
+	const __m128i seven{ _mm_set1_epi32(7) };
+	const __m128i lattice{ _mm_set1_epi32(~7) };
+	const __m128i lx{ _mm_set1_epi32(rect.x) };
+	const __m128i ly{ _mm_set1_epi32(rect.y) };
+	const __m128i lx1{ _mm_set1_epi32(rect.x - 1) };
+	const __m128i ly1{ _mm_set1_epi32(rect.y - 1) };
+	const __m128i lw{ _mm_set1_epi32(rect.w) };
+	const __m128i lh{ _mm_set1_epi32(rect.h) };
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i rx{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.x[i])) };
+		__m128i ry{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.y[i])) };
+		__m128i rw{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.w[i])) };
+		__m128i rh{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.h[i])) };
+		// SSE2 has no 32 bit max, so negative distances are masked to zero instead
+		__m128i dx{ _mm_sub_epi32(rx, lx1) };
+		__m128i dy{ _mm_sub_epi32(ry, ly1) };
+		__m128i fx{ _mm_and_si128(_mm_add_epi32(_mm_and_si128(dx, _mm_cmpgt_epi32(dx, zero)), seven), lattice) };
+		__m128i fy{ _mm_and_si128(_mm_add_epi32(_mm_and_si128(dy, _mm_cmpgt_epi32(dy, zero)), seven), lattice) };
+		__m128i hitx{ _mm_andnot_si128(_mm_cmpgt_epi32(fx, lw), _mm_cmpgt_epi32(_mm_add_epi32(rx, rw), _mm_add_epi32(lx, fx))) };
+		__m128i hity{ _mm_andnot_si128(_mm_cmpgt_epi32(fy, lh), _mm_cmpgt_epi32(_mm_add_epi32(ry, rh), _mm_add_epi32(ly, fy))) };
+		int mask{ _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(hitx, hity))) };
+		for (int k{ 0 }; k < 4; k++)
+			hits[i + k] = (mask >> k) & 1;
+	}
+#endif
+	for (; i < n; i++)
+		hits[i] = overlapAxis(rect.x, rect.w, batch.x[i], batch.w[i]) && overlapAxis(rect.y, rect.h, batch.y[i], batch.h[i]);
+}
+
+
+// for each position in the batch gets its squared distance from (px, py), and whether it lies within range[i] horizontally and rangeV
+// vertically of (cx, cy). Squares are taken in float, which is exact for the distances that are compared against.
+void proximityKernel(int px, int py, int cx, int cy, int rangeV, const RectBatch &batch, const std::vector<int> &range,
+	std::vector<float> &dist2, std::vector<Uint8> &inRange)
+{
+	int n{ batch.size() };
+	dist2.resize(n);
+	inRange.resize(n);
+	int i{ 0 };
+#if defined(__AVX2__)
+	const __m256i vpx{ _mm256_set1_epi32(px) };
+	const __m256i vpy{ _mm256_set1_epi32(py) };
+	const __m256i vcx{ _mm256_set1_epi32(cx) };
+	const __m256i vcy{ _mm256_set1_epi32(cy) };
+	const __m256i vrv{ _mm256_set1_epi32(rangeV) };
+	const __m256i nrv{ _mm256_set1_epi32(-rangeV) };
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i x{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.x[i])) };
+		__m256i y{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.y[i])) };
+		__m256i rh{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&range[i])) };
+		__m256 dx{ _mm256_cvtepi32_ps(_mm256_sub_epi32(x, vpx)) };
+		__m256 dy{ _mm256_cvtepi32_ps(_mm256_sub_epi32(y, vpy)) };
+		_mm256_storeu_ps(&dist2[i], _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+		// |a| < r is tested as -r < a < r, which needs no absolute value
+		__m256i ox{ _mm256_sub_epi32(x, vcx) };
+		__m256i oy{ _mm256_sub_epi32(y, vcy) };
+		__m256i inx{ _mm256_and_si256(_mm256_cmpgt_epi32(rh, ox), _mm256_cmpgt_epi32(ox, _mm256_sub_epi32(_mm256_setzero_si256(), rh))) };
+		__m256i iny{ _mm256_and_si256(_mm256_cmpgt_epi32(vrv, oy), _mm256_cmpgt_epi32(oy, nrv)) };
+		int mask{ _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(inx, iny))) };
+		for (int k{ 0 }; k < 8; k++)
+			inRange[i + k] = (mask >> k) & 1;
+	}
+#elif defined(BATCH_SSE2)
+	const __m128i vpx{ _mm_set1_epi32(px) };
+	const __m128i vpy{ _mm_set1_epi32(py) };
+	const __m128i vcx{ _mm_set1_epi32(cx) };
+	const __m128i vcy{ _mm_set1_epi32(cy) };
+	const __m128i vrv{ _mm_set1_epi32(rangeV) };
+	const __m128i nrv{ _mm_set1_epi32(-rangeV) };
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i x{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.x[i])) };
+		__m128i y{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.y[i])) };
+		__m128i rh{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&range[i])) };
+		__m128 dx{ _mm_cvtepi32_ps(_mm_sub_epi32(x, vpx)) };
+		__m128 dy{ _mm_cvtepi32_ps(_mm_sub_epi32(y, vpy)) };
+		_mm_storeu_ps(&dist2[i], _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+		__m128i ox{ _mm_sub_epi32(x, vcx) };
+		__m128i oy{ _mm_sub_epi32(y, vcy) };
+		__m128i inx{ _mm_and_si128(_mm_cmpgt_epi32(rh, ox), _mm_cmpgt_epi32(ox, _mm_sub_epi32(_mm_setzero_si128(), rh))) };
+		__m128i iny{ _mm_and_si128(_mm_cmpgt_epi32(vrv, oy), _mm_cmpgt_epi32(oy, nrv)) };
+		int mask{ _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(inx, iny))) };
+		for (int k{ 0 }; k < 4; k++)
+			inRange[i + k] = (mask >> k) & 1;
+	}
+#endif
+	for (; i < n; i++)
+	{
+		float dx{ static_cast<float>(batch.x[i] - px) };
+		float dy{ static_cast<float>(batch.y[i] - py) };
+		dist2[i] = dx * dx + dy * dy;
+		inRange[i] = abs(batch.x[i] - cx) < range[i] && abs(batch.y[i] - cy) < rangeV;
+	}
+}
+
+
+// every kind of thing a level cell can hold. Static terrain only ever exists in the tile map, the rest are spawned as objects.
+enum TileType : Uint8
+{
+	TILE_EMPTY,
+	TILE_WALL,
+	TILE_WATER,
+	TILE_THORNS,
+	TILE_ICE,
+	TILE_THINICE,
+	TILE_GEM100,
+	TILE_GEML,
+	TILE_SNAKE,
+	TILE_PTERO,
+	TILE_PLANT,
+	TILE_SPIT,
+	TILE_MUSHROOM,
+	TILE_TREE,
+	TILE_FLOWER,
+	TILE_FROG,
+	TILE_MAMMOTH,
+	TILE_YETI,
+	TILE_COUNT
+};
+
+
+// everything known about a type before any of it is created. The table itself is defined after the classes it constructs.
+struct TileInfo
+{
+	Object* (*spawn)(int x, int y, SDL_Renderer *ren); // creates the object for a dynamic type, nullptr for static terrain
+	bool isStatic; // drawn and collided with straight from the tile map
+	bool solid;
+	bool hazard;
+	bool enemy;
+	bool collectible;
+	bool slide; // whether the player slides when standing on it
+	double traction;
+	SDL_Rect hitbox; // relative to the top left of the cell
+	int score; // awarded when the player kills or collects it
+	int protectRange; // horizontal distance in pixels from the view within which it keeps updating, 0 if it doesn't
+	bool serial; // reads other dynamic objects while updating, so is never updated in parallel with them
+	std::vector<SDL_Texture*> *imageSet;
+};
+extern const TileInfo tileInfo[TILE_COUNT];
+static std::vector<SDL_Texture*> tileImages[TILE_COUNT]; // sprites for each type, shared by every instance
+
+
+// converts a level file tile code to the type it stands for in the given tileset
+Uint8 tileTypeOf(int tileSet, int code);
+
+
 
 
 
@@ -156,21 +1522,32 @@ protected:
 	int m_frame{ 0 };
 	double m_traction{ 0.5 };
 	SDL_Rect m_rect;
+	Uint8 m_type{ TILE_EMPTY };
 	Object(int x, int y, int w, int h, bool solid, bool hazard, bool enemy, bool collectible) :
 		m_x{ x }, m_y{ y }, m_startx{ x }, m_starty{ y }, m_rect{ x, y, w, h }, m_solid{ solid }, m_hazard{ hazard }, m_enemy{ enemy }, m_collectible{ collectible }
 	{}
+	// places an object of a registered type in the cell at (x, y), taking its hitbox and flags from the registry
+	Object(int x, int y, Uint8 type) :
+		Object(x + tileInfo[type].hitbox.x, y + tileInfo[type].hitbox.y, tileInfo[type].hitbox.w, tileInfo[type].hitbox.h, tileInfo[type].solid, 
+			tileInfo[type].hazard, tileInfo[type].enemy, tileInfo[type].collectible)
+	{
+		m_type = type;
+		m_traction = tileInfo[type].traction;
+	}
 public:
 	bool m_exists{ true };
 	// m_protected is used to protect an object from being removed from the update queue, for example it is used for enemies which are still
 	// on screen despite their starting position being off screen.
 	bool m_protected{ false };
+	bool m_dirty{ false }; // on its chunk's dirty list
+	float m_playerDist2{ 1e9f }; // squared distance from the player, measured each frame by the proximity batch
 	const int m_startx;
 	const int m_starty;
 	const bool m_solid;
 	const bool m_hazard;
 	const bool m_enemy;
 	const bool m_collectible;
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) = 0;
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) = 0;
 	virtual void reset() // returns object to its starting position
 	{
 		m_x = m_startx;
@@ -185,8 +1562,10 @@ public:
 	{
 		return m_rect;
 	}
-	virtual void action()
-	{}
+	virtual void action() // called when the player kills or collects it
+	{
+		g_score += tileInfo[m_type].score;
+	}
 	virtual void setFrame(int i)
 	{
 		m_frame = i;
@@ -195,8 +1574,577 @@ public:
 	{
 		return m_traction;
 	}
+	// whether walkers can stand on it, for solid types whose footing comes and goes
+	virtual bool safeGround()
+	{
+		return true;
+	}
+	// passes the state that changes in play through a snapshot, classes with more of it sync theirs after calling this
+	virtual void sync(Snapshot &s)
+	{
+		s.sync(m_x);
+		s.sync(m_y);
+		s.sync(m_frame);
+		s.sync(m_rect);
+		s.sync(m_exists);
+		s.sync(m_protected);
+	}
 	int getx() { return m_x; }
 	int gety() { return m_y; }
+	Uint8 getType() { return m_type; }
+	virtual ~Object()
+	{}
+};
+
+
+// ---------------LEVEL STREAMING---------------
+
+
+// orders objects the way they are laid out in the level file, row by row
+bool spawnOrder(Object *left, Object *right)
+{
+	if (left->m_starty / 32 != right->m_starty / 32)
+		return left->m_starty / 32 < right->m_starty / 32;
+	return left->m_startx / 32 < right->m_startx / 32;
+}
+
+
+// a fixed-width slice of level columns, resident only while near the camera
+struct Chunk
+{
+	std::vector<Uint8> tiles; // column-major, chunkW columns of g_levelH tile types each
+	std::vector<Object*> objects; // the dynamic objects spawned in this chunk
+	std::vector<Object*> dirty; // those that may have moved away from their spawn state since the last strong reset
+};
+
+
+// level storage that keeps only the chunks around the camera in memory. The file is indexed by row on load so that any column range
+// can be read back on demand, letting level length grow without growing memory. Static terrain is held as one byte per cell, and
+// only dynamic things become objects.
+class Level
+{
+private:
+	std::ifstream m_file;
+	std::vector<std::streamoff> m_rowOffsets; // file position of the first tile of each row
+	std::vector<int> m_rowLengths;
+	std::vector<Chunk*> m_chunks; // nullptr where a chunk is not resident
+	std::vector<std::string> m_packed; // run-length encoded tile codes of evicted chunks, if compression is on
+	std::set<int> m_collected; // cells whose collectible has been picked up, so reloading their chunk doesn't restore them
+	SDL_Renderer *m_ren{ nullptr };
+	int m_width{ 0 };
+	int m_height{ 0 };
+	int m_tileSet{ 0 };
+	int m_terrainSerial{ 0 }; // changes whenever the ground walkers can patrol might have, telling them to measure it again
+
+	// reads the tile codes of chunk c in column-major order, from the packed copy if there is one
+	void readCodes(int c, std::vector<int> &codes)
+	{
+		codes.assign(chunkW * m_height, 0);
+		if (!m_packed[c].empty()) // decode (count, code) pairs
+		{
+			int i{ 0 };
+			for (int j{ 0 }; j + 1 < m_packed[c].size(); j += 2)
+				for (int n{ 0 }; n < static_cast<unsigned char>(m_packed[c][j]); n++)
+					codes[i++] = static_cast<unsigned char>(m_packed[c][j + 1]) - 1;
+			return;
+		}
+		std::string line;
+		for (int y{ 0 }; y < m_height; y++)
+		{
+			int count{ std::min(chunkW, m_rowLengths[y] - c * chunkW) };
+			if (count <= 0)
+				continue;
+			line.resize(count);
+			m_file.clear();
+			m_file.seekg(m_rowOffsets[y] + c * chunkW);
+			m_file.read(&line[0], count);
+			for (int x{ 0 }; x < count; x++)
+				codes[x * m_height + y] = static_cast<int>(line[x] - 97);
+		}
+		if (g_chunkCompression) // pack the codes so the next visit doesn't go back to disk
+		{
+			for (int i{ 0 }; i < codes.size();)
+			{
+				int run{ 1 };
+				while (i + run < codes.size() && codes[i + run] == codes[i] && run < 255)
+					run++;
+				m_packed[c] += static_cast<char>(run);
+				m_packed[c] += static_cast<char>(codes[i] + 1);
+				i += run;
+			}
+		}
+	}
+	// builds a whole chunk in one pass over its codes, filling the tile map and spawning the dynamic types through the registry
+	void loadChunk(int c)
+	{
+		std::vector<int> codes;
+		readCodes(c, codes);
+		Chunk *chunk{ new Chunk };
+		chunk->tiles.resize(codes.size());
+		int dynamic{ 0 };
+		for (int i{ 0 }; i < codes.size(); i++)
+		{
+			chunk->tiles[i] = tileTypeOf(m_tileSet, codes[i]);
+			if (tileInfo[chunk->tiles[i]].spawn)
+				dynamic++;
+		}
+		chunk->objects.reserve(dynamic);
+		for (int i{ 0 }; i < codes.size() && dynamic > 0; i++)
+		{
+			const TileInfo &info{ tileInfo[chunk->tiles[i]] };
+			if (!info.spawn)
+				continue;
+			int gx{ c * chunkW + i / m_height };
+			int gy{ i % m_height };
+			Object *ptr{ info.spawn(gx * 32, gy * 32, m_ren) };
+			if (m_collected.count(gx * m_height + gy))
+			{
+				ptr->m_exists = false;
+				ptr->m_dirty = true;
+				chunk->dirty.push_back(ptr);
+			}
+			chunk->objects.push_back(ptr);
+			dynamic--;
+		}
+		m_chunks[c] = chunk;
+		m_terrainSerial++;
+	}
+	// deletes a resident chunk and its objects
+	void freeChunk(int c)
+	{
+		for (Object *ptr : m_chunks[c]->objects)
+			delete ptr;
+		delete m_chunks[c];
+		m_chunks[c] = nullptr;
+		m_terrainSerial++;
+	}
+	// deletes a resident chunk, unless it owns an object which is still protected on screen
+	bool evictChunk(int c)
+	{
+		for (Object *ptr : m_chunks[c]->objects)
+			if (ptr->m_protected)
+				return false;
+		for (Object *ptr : m_chunks[c]->objects)
+			if (ptr->m_collectible && !ptr->m_exists)
+				m_collected.insert(ptr->m_startx / 32 * m_height + ptr->m_starty / 32);
+		freeChunk(c);
+		return true;
+	}
+	// gets the world space hitbox of a static tile
+	SDL_Rect tileRect(int y, int x, Uint8 type)
+	{
+		const SDL_Rect &hitbox{ tileInfo[type].hitbox };
+		return { x * 32 + hitbox.x, y * 32 + hitbox.y, hitbox.w, hitbox.h };
+	}
+	// whether a static tile blocks movement (solid) or kills (hazard)
+	bool blocks(Uint8 type, bool solid)
+	{
+		return tileInfo[type].isStatic && (solid ? tileInfo[type].solid : tileInfo[type].hazard);
+	}
+	// whether a walker with its body in rows y0 to y1 can be in column x: nothing solid (or, if hazards, no static hazard) in its way
+	// and safe ground underneath
+	bool walkable(int x, int y0, int y1, bool hazards)
+	{
+		for (int y{ y0 }; y <= y1; y++)
+		{
+			Uint8 type{ tile(y, x) };
+			if (tileInfo[type].solid || (hazards && blocks(type, false)))
+				return false;
+		}
+		Uint8 ground{ tile(y1 + 1, x) };
+		if (!tileInfo[ground].solid || tileInfo[ground].hazard)
+			return false;
+		if (tileInfo[ground].isStatic)
+			return true;
+		Object *ptr{ objectAt(x, y1 + 1) };
+		return ptr && ptr->safeGround();
+	}
+public:
+	~Level()
+	{
+		clear();
+	}
+	// opens a level file and indexes its rows, returning false if it couldn't be read
+	bool load(const std::string &path, SDL_Renderer *ren, int *tileSet, bool *weather, int *track)
+	{
+		clear();
+		m_ren = ren;
+		m_file.open(path, std::ios::binary);
+		if (!m_file.is_open())
+			return false;
+		std::string line;
+		std::getline(m_file, line);
+		*weather = static_cast<int>(line.at(0) - 48); // read weather effect
+		*track = static_cast<int>(line.at(1) - 48); // read music track
+		*tileSet = static_cast<int>(line.at(2) - 48); // read tileset used
+		m_tileSet = *tileSet;
+		std::streamoff offset{ m_file.tellg() };
+		while (std::getline(m_file, line)) // record where each row starts rather than storing it
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			m_rowOffsets.push_back(offset);
+			m_rowLengths.push_back(line.size());
+			offset = m_file.tellg();
+		}
+		m_height = m_rowOffsets.size();
+		m_width = m_height ? m_rowLengths[0] : 0;
+		m_chunks.assign(m_width / chunkW + 1, nullptr);
+		m_packed.assign(m_chunks.size(), "");
+		return m_height > 0;
+	}
+	// deletes every resident object and forgets the current file
+	void clear()
+	{
+		for (int c{ 0 }; c < m_chunks.size(); c++)
+			if (m_chunks[c])
+				freeChunk(c);
+		m_chunks.clear();
+		m_packed.clear();
+		m_collected.clear();
+		m_rowOffsets.clear();
+		m_rowLengths.clear();
+		if (m_file.is_open())
+			m_file.close();
+		m_width = 0;
+		m_height = 0;
+	}
+	// loads the chunks ahead of and around grid column gridx and evicts those left behind
+	void stream(int gridx)
+	{
+		int first{ std::max(0, (gridx - viewRangeH - streamMargin) / chunkW) };
+		int last{ std::min(static_cast<int>(m_chunks.size()) - 1, (gridx + viewRangeH + streamMargin) / chunkW) };
+		for (int c{ 0 }; c < m_chunks.size(); c++)
+		{
+			if (c >= first && c <= last)
+			{
+				if (!m_chunks[c])
+					loadChunk(c);
+			}
+			else if (m_chunks[c])
+				evictChunk(c);
+		}
+	}
+	// the type of a cell, or TILE_EMPTY if it is outside the level or not resident
+	Uint8 tile(int y, int x)
+	{
+		if (y < 0 || y >= m_height || x < 0 || x >= m_width || !m_chunks[x / chunkW])
+			return TILE_EMPTY;
+		return m_chunks[x / chunkW]->tiles[(x % chunkW) * m_height + y];
+	}
+	// appends the objects spawned within the given cell range, in level file order
+	void objectsIn(int x0, int x1, int y0, int y1, std::vector<Object*> &out)
+	{
+		int start = out.size();
+		for (int c{ std::max(0, x0 / chunkW) }; c <= x1 / chunkW && c < m_chunks.size(); c++)
+		{
+			if (!m_chunks[c])
+				continue;
+			for (Object *ptr : m_chunks[c]->objects)
+			{
+				int x{ ptr->m_startx / 32 };
+				int y{ ptr->m_starty / 32 };
+				if (x >= x0 && x <= x1 && y >= y0 && y <= y1)
+					out.push_back(ptr);
+			}
+		}
+		std::sort(out.begin() + start, out.end(), spawnOrder);
+	}
+	// the object spawned in cell (x, y), or nullptr if there is none or its chunk isn't resident
+	Object* objectAt(int x, int y)
+	{
+		if (x < 0 || x / chunkW >= m_chunks.size() || !m_chunks[x / chunkW])
+			return nullptr;
+		for (Object *ptr : m_chunks[x / chunkW]->objects)
+			if (ptr->m_startx / 32 == x && ptr->m_starty / 32 == y)
+				return ptr;
+		return nullptr;
+	}
+	// measures the stretch of columns a ground walker in column x with its body in rows y0 to y1 can patrol, up to the first wall
+	// or ledge either side. Only resident chunks are seen, which is why loading or evicting one changes the terrain serial.
+	void walkSpan(int x, int y0, int y1, bool hazards, int *left, int *right)
+	{
+		*left = x;
+		*right = x;
+		while (*left > 0 && walkable(*left - 1, y0, y1, hazards))
+			(*left)--;
+		while (*right < m_width - 1 && walkable(*right + 1, y0, y1, hazards))
+			(*right)++;
+	}
+	// a dynamic tile has changed whether it can be walked over or on
+	void terrainChanged() { m_terrainSerial++; }
+	int terrainSerial() { return m_terrainSerial; }
+	// notes that an object is being made active, as only then can it move away from its spawn state
+	void markDirty(Object *ptr)
+	{
+		if (ptr->m_dirty)
+			return;
+		ptr->m_dirty = true;
+		m_chunks[ptr->m_startx / 32 / chunkW]->dirty.push_back(ptr);
+	}
+	// passes the collected cells, which chunks are resident and the state of every object in them through a snapshot. Loading brings
+	// the resident chunks back to what they were, so the objects are synced in the order they were saved.
+	void sync(Snapshot &s)
+	{
+		int collected{ s.syncCount(m_collected.size()) };
+		if (s.loading())
+		{
+			m_terrainSerial++;
+			m_collected.clear();
+			for (int i{ 0 }; i < collected; i++)
+			{
+				int cell{ 0 };
+				s.sync(cell);
+				m_collected.insert(cell);
+			}
+		}
+		else
+			for (int cell : m_collected)
+				s.sync(cell);
+		for (int c{ 0 }; c < m_chunks.size(); c++)
+		{
+			bool resident{ m_chunks[c] != nullptr };
+			s.sync(resident);
+			if (s.loading() && resident && !m_chunks[c])
+				loadChunk(c);
+			else if (s.loading() && !resident && m_chunks[c])
+				freeChunk(c);
+			if (resident)
+				for (Object *ptr : m_chunks[c]->objects)
+				{
+					ptr->sync(s);
+					if (s.loading())
+						markDirty(ptr);
+				}
+		}
+	}
+	// moves rect back by (xstep, ystep) out of any static solid (or hazard) tile it overlaps, returning true if it had to move
+	bool alignTiles(SDL_Rect &rect, int xstep, int ystep, bool solid)
+	{
+		bool rvalue{ false };
+		for (int y{ rect.y / 32 - 1 }; y <= (rect.y + rect.h) / 32 + 1; y++)
+			for (int x{ rect.x / 32 - 1 }; x <= (rect.x + rect.w) / 32 + 1; x++)
+			{
+				Uint8 type{ tile(y, x) };
+				if (!blocks(type, solid))
+					continue;
+				SDL_Rect trect{ tileRect(y, x, type) };
+				if (align(rect, trect, xstep, ystep))
+					rvalue = true;
+			}
+		return rvalue;
+	}
+	// the last static solid (or hazard) tile overlapping rect, or nullptr if there is none
+	const TileInfo* touching(SDL_Rect &rect, bool solid)
+	{
+		const TileInfo *info{ nullptr };
+		for (int y{ rect.y / 32 - 1 }; y <= (rect.y + rect.h) / 32 + 1; y++)
+			for (int x{ rect.x / 32 - 1 }; x <= (rect.x + rect.w) / 32 + 1; x++)
+			{
+				Uint8 type{ tile(y, x) };
+				if (!blocks(type, solid))
+					continue;
+				SDL_Rect trect{ tileRect(y, x, type) };
+				if (collided(rect, trect))
+					info = &tileInfo[type];
+			}
+		return info;
+	}
+	// draws the solid or non-solid static tiles on screen in the activation window about (gridx, gridy). (offx, offy) converts world
+	// coordinates to screen coordinates.
+	void drawTiles(SDL_Renderer *ren, int offx, int offy, int gridx, int gridy, bool solid)
+	{
+		for (int y{ gridy - viewRangeV }; y <= gridy + viewRangeV; y++)
+			for (int x{ gridx - viewRangeH }; x <= gridx + viewRangeH; x++)
+			{
+				Uint8 type{ tile(y, x) };
+				if (!tileInfo[type].isStatic || tileInfo[type].solid != solid)
+					continue;
+				SDL_Rect vrect{ offx + x * 32, offy + y * 32 + tileInfo[type].hitbox.y, 32, 32 };
+				if (!visible({ vrect.x - 2, vrect.y - 4, 36, 36 })) // with room for the grass on top of walls
+					continue;
+				std::vector<SDL_Texture*> &imageSet{ *tileInfo[type].imageSet };
+				switch (type)
+				{
+				case TILE_WALL:
+				{
+					// draws borders on each side with no adjacent solid block, except at the level boundaries
+					int frame{ m_tileSet * 5 };
+					SDL_RenderCopy(ren, imageSet[frame], NULL, &vrect);
+					if (x > 0 && !tileInfo[tile(y, x - 1)].solid)
+						SDL_RenderCopy(ren, imageSet[frame + 2], NULL, &vrect);
+					if (y < m_height - 1 && !tileInfo[tile(y + 1, x)].solid)
+						SDL_RenderCopy(ren, imageSet[frame + 3], NULL, &vrect);
+					if (x < m_width - 1 && !tileInfo[tile(y, x + 1)].solid)
+						SDL_RenderCopy(ren, imageSet[frame + 4], NULL, &vrect);
+					if (y > 0 && !tileInfo[tile(y - 1, x)].solid) // draws grass if no block above
+					{
+						vrect.y -= 4;
+						vrect.x -= 2;
+						vrect.h = 34;
+						vrect.w = 36;
+						SDL_RenderCopy(ren, imageSet[frame + 1], NULL, &vrect);
+					}
+					break;
+				}
+				case TILE_WATER:
+				{
+					// the top block of water shows a wave animation
+					const TileInfo &above{ tileInfo[tile(y - 1, x)] };
+					int frame{ 2 };
+					if (y > 0 && !above.solid && !(above.hazard && !above.enemy))
+						frame = (g_count % 40 < 20);
+					SDL_RenderCopy(ren, imageSet[frame], NULL, &vrect);
+					break;
+				}
+				case TILE_THORNS:
+					SDL_RenderCopy(ren, imageSet[m_tileSet], NULL, &vrect);
+					break;
+				case TILE_ICE:
+					SDL_RenderCopy(ren, imageSet[0], NULL, &vrect);
+					break;
+				}
+			}
+	}
+	// strongly resets the resident objects that have been active since the last time and restores collected ones in evicted chunks.
+	// Objects never made active are as they were spawned, so this costs as much as the player reached rather than the level's size.
+	void resetStrong()
+	{
+		m_collected.clear();
+		m_terrainSerial++;
+		for (Chunk *chunk : m_chunks)
+			if (chunk)
+			{
+				for (Object *ptr : chunk->dirty)
+				{
+					ptr->resetStrong();
+					ptr->m_dirty = false;
+				}
+				chunk->dirty.clear();
+			}
+	}
+	int width() { return m_width; }
+	int height() { return m_height; }
+};
+
+
+// tells the level a dynamic tile changed whether walkers can cross it, or records it for later if the tile is being updated in
+// parallel, as the terrain serial is shared
+void changeTerrain(Level &level)
+{
+	if (t_deferred)
+		t_deferred->terrainChanged = true;
+	else
+		level.terrainChanged();
+}
+
+
+// the stretch of ground a walker patrols as the range its x can take, measured from the level when first needed and again only
+// when the terrain serial changes, so that turning at walls and ledges is a bound check rather than a look at the tiles around it
+struct PatrolSpan
+{
+	int serial{ -1 };
+	int minx{ 0 };
+	int maxx{ 0 };
+	// keeps x within the span of a walker with hitbox rect, returning 1 if it reached the left end, -1 if the right and 0 otherwise.
+	// If hazards is set, static hazards are walls as well as ledges.
+	int clamp(Level &level, const SDL_Rect &rect, int &x, bool hazards)
+	{
+		if (serial != level.terrainSerial())
+		{
+			serial = level.terrainSerial();
+			int left, right;
+			level.walkSpan((rect.x + rect.w / 2) / 32, rect.y / 32, (rect.y + rect.h - 1) / 32, hazards, &left, &right);
+			minx = left * 32;
+			maxx = std::max(minx, (right + 1) * 32 - rect.w);
+		}
+		if (x <= minx)
+		{
+			x = minx;
+			return 1;
+		}
+		if (x >= maxx)
+		{
+			x = maxx;
+			return -1;
+		}
+		return 0;
+	}
+};
+
+
+// loads the next level on a worker thread while the current one is played, so that moving between levels doesn't stall
+class Preloader
+{
+private:
+	std::thread m_thread;
+	std::string m_path;
+	Level *m_level{ nullptr };
+	bool m_loaded{ false };
+	std::atomic<bool> m_done{ false }; // the worker thread has finished
+	int m_tileSet{ 0 };
+	bool m_weather{ false };
+	int m_track{ 0 };
+
+	// worker thread body, frees the finished level then reads, parses and builds the first chunks of the next
+	void run(Level *old, SDL_Renderer *ren)
+	{
+		delete old;
+		m_loaded = m_level->load(m_path, ren, &m_tileSet, &m_weather, &m_track);
+		if (m_loaded)
+			m_level->stream(screenw / 64); // the region play starts in
+		m_done = true;
+	}
+	void join()
+	{
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+public:
+	~Preloader()
+	{
+		join();
+		delete m_level;
+	}
+	// starts loading the level at path, handing over the previous level (if any) to be deleted off the main thread
+	void start(const std::string &path, SDL_Renderer *ren, Level *old)
+	{
+		join();
+		delete m_level;
+		m_path = path;
+		m_level = new Level;
+		m_done = false;
+		m_thread = std::thread(&Preloader::run, this, old, ren);
+	}
+	// whether the level at path is being (or has been) loaded
+	bool loading(const std::string &path)
+	{
+		return m_level && m_path == path;
+	}
+	// whether the level being loaded can be taken without waiting
+	bool ready()
+	{
+		return m_done;
+	}
+	// waits for the level at path to finish loading and takes ownership of it. If a different level was being loaded it is
+	// thrown away and path is loaded now instead.
+	Level* take(const std::string &path, SDL_Renderer *ren, int *tileSet, bool *weather, int *track)
+	{
+		join();
+		if (!m_level || m_path != path || !m_loaded)
+		{
+			delete m_level;
+			m_path = path;
+			m_level = new Level;
+			m_loaded = m_level->load(path, ren, &m_tileSet, &m_weather, &m_track);
+		}
+		Level *level{ m_level };
+		m_level = nullptr;
+		*tileSet = m_tileSet;
+		*weather = m_weather;
+		*track = m_track;
+		return level;
+	}
 };
 
 
@@ -213,6 +2161,17 @@ private:
 	SDL_Rect m_rect;
 	bool m_grounded{ true };
 	bool m_jumping{ false };
+	bool m_jumpNoise{ false }; // the jump sound was started and hasn't been cut out yet
+	RectBatch m_targets; // rects of the enemies or hazards being tested, kept between frames so their storage is reused
+	std::vector<Uint8> m_hits;
+	// tests the player against every object in the group in one batch, leaving the results in m_hits
+	void overlapAll(std::vector<Object*> *objects)
+	{
+		m_targets.clear();
+		for (Object *ptr : *objects)
+			m_targets.push(ptr->getRect());
+		overlapKernel(m_rect, m_targets, m_hits);
+	}
 public:
 	static std::vector<SDL_Texture*> m_imageSet;
 	static std::vector<Mix_Chunk*> m_sounds;
@@ -226,7 +2185,7 @@ public:
 		SDL_Rect vrect{ v_x - 2, v_y, 32, 32 }; // (offset better fits the sprite to the hitbox)
 		SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, static_cast<SDL_RendererFlip>(m_flip));
 	}
-	int update(SDL_Renderer *ren, std::vector<Object*> *solids, std::vector<Object*> *hazards, std::vector<Object*> *enemies, 
+	int update(SDL_Renderer *ren, Level &level, std::vector<Object*> *solids, std::vector<Object*> *hazards, std::vector<Object*> *enemies, 
 		std::vector<Object*> *collectibles)
 	{
 		int result = 0;
@@ -237,19 +2196,23 @@ public:
 		// first moves player downwards to check if standing on a solid object
 		m_rect.y += 1;
 		m_grounded = false;
+		const TileInfo *ground{ level.touching(m_rect, true) };
+		if (ground) // standing on static terrain
+		{
+			m_grounded = true;
+			acc = ground->traction;
+			slide = ground->slide;
+		}
 		for (int i{ 0 }; i < solids->size(); i++)
 		{
 			if (collided(m_rect, solids->at(i)->getRect()))
 
 			{
 				m_grounded = true;
-				// handles slipping on icy objects (stupid to check for specific classes, update object with additional property?)
+				// handles slipping on icy objects, which the registry marks the same way as icy terrain
 				acc = solids->at(i)->getTraction();
-				std::string className = typeid(*solids->at(i)).name();
-				if (className == "class Ice" || className == "class ThinIce")
-				{
+				if (tileInfo[solids->at(i)->getType()].slide)
 					slide = true;
-				}
 			}
 		}
 		m_rect.y -= 1; // (undos shift downwards)
@@ -289,7 +2252,8 @@ public:
 			{
 				m_jumping = true;
 				m_vspd = -10;
-				Mix_PlayChannel(7, m_sounds[1], 0);
+				g_audio.play(7, m_sounds[1]);
+				m_jumpNoise = true;
 			}
 		}
 		else if (m_jumping) // if jump key released during a jump
@@ -297,8 +2261,11 @@ public:
 			m_jumping = false; // shorten jump height
 			m_vspd *= 0.5;
 		}
-		if (!m_jumping && Mix_Playing(7)) // cuts out jumping noise
-			Mix_FadeOutChannel(7, 125);
+		if (!m_jumping && m_jumpNoise) // cuts out jumping noise
+		{
+			g_audio.fadeOut(7, 125);
+			m_jumpNoise = false;
+		}
 		if (m_jumping && m_vspd > 0)
 			m_jumping = false;
 
@@ -310,6 +2277,9 @@ public:
 		m_x += m_hspd;
 		m_rect = { m_x, m_y, 28, 32 };
 		// now check for collisions with solid blocks
+		if (level.alignTiles(m_rect, m_hspd / abs(m_hspd), 0, true))
+			m_hspd = 0;
+		m_x = m_rect.x;
 		for (int i{ 0 }; i < solids->size(); i++)
 		{
 			if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0))
@@ -321,6 +2291,9 @@ public:
 		// does the same as above for y movement
 		m_y += m_vspd;
 		m_rect = { m_x, m_y, 28, 32 };
+		if (level.alignTiles(m_rect, 0, m_vspd / abs(m_vspd), true))
+			m_vspd = 0;
+		m_y = m_rect.y;
 		for (int i{ 0 }; i < solids->size(); i++)
 		{
 			if (align(m_rect, solids->at(i)->getRect(), 0, m_vspd / abs(m_vspd)))
@@ -340,9 +2313,10 @@ public:
 		// enemy collision
 		m_rect.y += 1;
 		bool enemyhit{ 0 };
+		overlapAll(enemies);
 		for (int i{ 0 }; i < enemies->size(); i++)
 		{
-			if (enemies->at(i)->m_exists && collided(m_rect, enemies->at(i)->getRect()))
+			if (enemies->at(i)->m_exists && m_hits[i])
 			{
 				if (m_y + 16 < enemies->at(i)->gety()) // if player high enough above enemy
 				{
@@ -356,7 +2330,8 @@ public:
 					else // small bounce otherwise
 						m_vspd = -4;
 					enemies->at(i)->action(); // change score
-					Mix_PlayChannel(7, m_sounds[1], 0);
+					g_audio.play(7, m_sounds[1]);
+					m_jumpNoise = true;
 					break;
 				}
 				else if (enemyhit) // kills any additional enemies hit if already successfully bouncing off of an enemy
@@ -365,8 +2340,11 @@ public:
 		}
 
 		// hazard collision
+		if (level.touching(m_rect, false)) // static hazards
+			result = -1;
+		overlapAll(hazards);
 		for (int i{ 0 }; i < hazards->size(); i++)
-			if (hazards->at(i)->m_exists && collided(m_rect, hazards->at(i)->getRect())) // if in contact with hazard
+			if (hazards->at(i)->m_exists && m_hits[i]) // if in contact with hazard
 				result = -1; // kill player
 		m_rect.y -= 1;
 
@@ -376,7 +2354,7 @@ public:
 			{
 				collectibles->at(i)->m_exists = false;
 				collectibles->at(i)->action();
-				Mix_PlayChannel(-1, m_sounds[0], 0);
+				g_audio.play(-1, m_sounds[0]);
 			}
 
 		// drawing
@@ -403,6 +2381,22 @@ public:
 
 		return result;
 	}
+	// passes the player's state through a snapshot, the batch buffers being scratch space aren't part of it
+	void sync(Snapshot &s)
+	{
+		s.sync(m_x);
+		s.sync(m_y);
+		s.sync(m_frame);
+		s.sync(m_flip);
+		s.sync(m_hspd);
+		s.sync(m_vspd);
+		s.sync(m_rect);
+		s.sync(m_grounded);
+		s.sync(m_jumping);
+		s.sync(m_jumpNoise);
+		s.sync(v_x);
+		s.sync(v_y);
+	}
 	SDL_Rect getRect() { return m_rect; }
 	int getx() { return m_x; }
 	int gety() { return m_y; }
@@ -414,137 +2408,6 @@ std::vector<Mix_Chunk*> Player::m_sounds{ 0 };
 // ---------------LEVEL STRUCTURE---------------
 
 
-// walls that make up the level
-class Wall : public Object
-{
-private:
-	bool m_check{ false };
-	std::vector<bool> m_adjacent{ true, true, true, true }; // whether another block exists to the top, left, bottom, or right
-public:
-	static std::vector<SDL_Texture*>m_imageSet;
-	Wall(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, true, false, false, false)
-	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, 
-		std::vector<Object*> *hazards) override
-	{
-		if (!m_check) // performs adjacency checks to fill out m_adjacent on first frame updated
-		{
-			int yx[2]{ m_y, m_x };
-			int checks[4]{ 0, 0, -g_levelH + 1, -g_levelW + 1 }; // level boundaries to check against
-			for (int i{ 0 }; i < 4; i++)
-			{
-				// checks the four sides for the level boundaries or adjacent blocks
-				int sign = pow(-1, i / 2); // positive first two i, negative last two i
-				if (sign * (yx[i % 2] / 32 - sign) < checks[i])
-					m_adjacent[i] = false;
-				else if (level[m_y / 32 - sign * ((i + 1) % 2)][m_x / 32 - sign * (i % 2)] != 0)
-				{
-					if (level[m_y / 32 - sign * ((i + 1) % 2)][m_x / 32 - sign * (i % 2)]->m_solid == true)
-						m_adjacent[i] = false;
-				}
-			}
-			m_check = true;
-		}
-
-		// calculates draw position, e.g.: p->v_x + (m_x - p->getx()) = viewpoint center + relative position
-		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		SDL_RenderCopy(ren, m_imageSet[m_frame], NULL, &vrect);
-		for (int i{ 2 }; i < 5; i++)
-		{
-			// draws borders on each side with no adjacent block
-			if (m_adjacent[i - 1])
-				SDL_RenderCopy(ren, m_imageSet[m_frame + i], NULL, &vrect);
-		}
-		if (m_adjacent[0]) // draws grass if no block above
-		{
-			vrect.y -= 4;
-			vrect.x -= 2;
-			vrect.h = 34;
-			vrect.w = 36;
-			SDL_RenderCopy(ren, m_imageSet[m_frame + 1], NULL, &vrect);
-		}
-	}
-};
-std::vector<SDL_Texture*> Wall::m_imageSet{ 0 };
-
-
-// water hazards
-class Water : public Object
-{
-private:
-	bool m_check{ false };
-	bool m_top{ true };
-public:
-	static std::vector<SDL_Texture*>m_imageSet;
-	Water(int x, int y, SDL_Renderer *ren) :
-		Object(x, y + 3, 32, 29, false, true, false, false)
-	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
-	{
-		if (!m_check) // checks if top block of water on first frame updated
-		{
-			Object *ptr{ level[m_y / 32 - 1][m_x / 32] };
-			if (m_y / 32 - 1 < 0)
-				m_top = false;
-			else if (ptr != 0)
-				if (ptr->m_solid || ptr->m_hazard && !ptr->m_enemy)
-					m_top = false;
-			m_check = true;
-		}
-		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		if (m_top) // if top block then draw wave animation
-		{
-			if (g_count % 40 == 0)
-				m_frame = 1;
-			else if (g_count % 40 == 20)
-				m_frame = 0;
-		}
-		else
-			m_frame = 2;
-		SDL_RenderCopy(ren, m_imageSet[m_frame], NULL, &vrect);
-	}
-};
-std::vector<SDL_Texture*> Water::m_imageSet{ 0 };
-
-
-// thorn hazards
-class Thorns : public Object
-{
-public:
-	static std::vector<SDL_Texture*>m_imageSet;
-	Thorns(int x, int y, SDL_Renderer *ren) :
-		Object(x, y + 3, 32, 29, false, true, false, false)
-	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
-	{
-		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		SDL_RenderCopy(ren, m_imageSet[m_frame], NULL, &vrect);
-	}
-};
-std::vector<SDL_Texture*> Thorns::m_imageSet{ 0 };
-
-
-// ice that the player slides on
-class Ice : public Object
-{
-public:
-	static std::vector<SDL_Texture*>m_imageSet;
-	Ice(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, true, false, false, false)
-	{
-		m_traction = 0.1;
-	}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, 
-		std::vector<Object*> *hazards) override
-	{
-		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		SDL_RenderCopy(ren, m_imageSet[0], NULL, &vrect);
-	}
-};
-std::vector<SDL_Texture*> Ice::m_imageSet{ 0 };
-
-
 // thin ice that cracks to water after the player steps on it, and eventually refreezes
 class ThinIce : public Object
 {
@@ -553,18 +2416,17 @@ private:
 	int m_timerBase{ -1 }; // startpoint for refreeze timer
 	int m_frame{ 0 };
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	ThinIce(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, true, false, false, false)
-	{
-		m_traction = 0.1;
-	}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+		Object(x, y, TILE_THINICE)
+	{}
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_cracks == 40) // if ice cracked
 		{
 			if (m_timerBase == -1) // if first frame cracked
 			{
+				changeTerrain(level); // walkers no longer cross it
 				m_timerBase = g_count; // start the refreeze timer at the current frame
 				// draw as water and update hitbox
 				m_frame = 4;
@@ -574,20 +2436,21 @@ public:
 			else
 			{
 				// try find this object in the hazards vector
-				auto i{ std::find(hazards->begin(), hazards->end(), static_cast<Object*>(this)) };
+				bool hazard{ isHazard(hazards, this) };
 				if (g_count - m_timerBase < 100) // if not refrozen yet
 				{
-					if (i == hazards->end()) // if failed to find object in hazards
-						hazards->push_back(static_cast<Object*>(this)); // add to hazards
+					if (!hazard) // if failed to find object in hazards
+						addHazard(hazards, this); // add to hazards
 					// water animation
 					if (g_count % 40 == 0)
 						m_frame = 5;
 					else if (g_count % 40 == 20)
 						m_frame = 4;
 				}
-				else if (i != hazards->end()) // if refrozen and still in hazards
+				else if (hazard) // if refrozen and still in hazards
 				{
-					hazards->erase(i); // remove from hazards
+					removeHazard(hazards, this); // remove from hazards
+					changeTerrain(level);
 					// reset variables, returning to ice
 					m_timerBase = -1;
 					m_frame = 0;
@@ -606,7 +2469,18 @@ public:
 				m_cracks -= 1;
 		}
 		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		SDL_RenderCopy(ren, m_imageSet[m_frame], NULL, &vrect);
+		drawSprite(ren, m_imageSet[m_frame], vrect);
+	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_cracks);
+		s.sync(m_timerBase);
+		s.sync(m_frame);
+	}
+	virtual bool safeGround() override
+	{
+		return m_cracks < 40;
 	}
 	virtual void reset() override
 	{
@@ -620,54 +2494,60 @@ public:
 		}
 	}
 };
-std::vector<SDL_Texture*> ThinIce::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &ThinIce::m_imageSet{ tileImages[TILE_THINICE] };
 
 
 // these three classes are for additional cosmetic objects I ended up not using
 class Scenery3 : public Object
 {
 private:
-	int m_type{ 0 };
+	int m_height{ 0 }; // tiles down to the ground less one, which picks the sprite and how tall it is drawn
 	bool m_check{ false };
-	std::vector<SDL_Texture*> m_imageSet;
+	std::vector<SDL_Texture*> &m_imageSet;
 public:
-	Scenery3(int x, int y, SDL_Renderer *ren,  std::vector<SDL_Texture*> imageSet) :
-		Object(x, y, 32, 32, false, false, false, false), m_imageSet{ imageSet }
+	Scenery3(int x, int y, SDL_Renderer *ren, Uint8 type) :
+		Object(x, y, type), m_imageSet{ *tileInfo[type].imageSet }
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_check)
 		{
 			for (int i{ 1 }; i < 4; i++)
-				if (level[m_y / 32 + i][m_x / 32] != 0 && level[m_y / 32 + i][m_x / 32]->m_solid == true)
+				if (tileInfo[level.tile(m_y / 32 + i, m_x / 32)].solid)
 				{
-					m_type = i - 1;
+					m_height = i - 1;
 					break;
 				}
 			m_check = true;
 		}
-		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 * (m_type + 1) };
-		SDL_RenderCopy(ren, m_imageSet[m_type], NULL, &vrect);
+		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 * (m_height + 1) };
+		drawSprite(ren, m_imageSet[m_height], vrect);
+	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_height);
+		s.sync(m_check);
 	}
 };
 class Tree : public Scenery3
 {
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Tree(int x, int y, SDL_Renderer *ren) :
-		Scenery3{ x, y, ren, m_imageSet }
+		Scenery3{ x, y, ren, TILE_TREE }
 	{}
 };
-std::vector<SDL_Texture*> Tree::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Tree::m_imageSet{ tileImages[TILE_TREE] };
 class Flower : public Scenery3
 {
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Flower(int x, int y, SDL_Renderer *ren) :
-		Scenery3{ x, y, ren, m_imageSet }
+		Scenery3{ x, y, ren, TILE_FLOWER }
 	{}
 };
-std::vector<SDL_Texture*> Flower::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Flower::m_imageSet{ tileImages[TILE_FLOWER] };
 
 
 // ---------------LEVEL FEATURES---------------
@@ -679,12 +2559,13 @@ class Snake : public Object
 private:
 	int m_hspd{ 2 };
 	bool m_flip{ 0 };
+	PatrolSpan m_span;
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Snake(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 16, 32, false, true, true, false) // 16, 32
+		Object(x, y, TILE_SNAKE)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
@@ -692,72 +2573,63 @@ public:
 			{
 				m_frame = (m_frame + 1) % 2; // advance animation to next frame
 				m_x += m_hspd; // move forward
+				int turn{ m_span.clamp(level, m_rect, m_x, false) };
+				if (turn) // turn around at walls and ledges
+					m_hspd = turn * abs(m_hspd);
 				m_rect = { m_x, m_y, m_rect.w, m_rect.h }; // update collision rect
-				int start = m_hspd;
-				for (int i{ 0 }; i < solids->size(); i++) // check for horizontal collisions
-				{
-					if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0)) // if a collision found
-						m_hspd = -start; // reverse direction
-					m_x = m_rect.x;
-				}
-				// the object in front and below the snake (i.e. the next object it will walk on)
-				Object *adjacent1 = level[m_y / 32 + 1][(m_x + 8 + 32 * m_hspd / abs(m_hspd)) / 32];
-				// the object behind and below the snake
-				Object *adjacent2 = level[m_y / 32 + 1][(m_x + 8 - 32 * m_hspd / abs(m_hspd)) / 32];
-				if (adjacent1 == nullptr) // if empty space in front and below the snake (i.e. at a ledge)
-				{
-					if (adjacent2 != nullptr) // and solid block behind and below
-						m_hspd *= -1; // turn around
-				}
-				else if (!adjacent1->m_solid || adjacent1->m_hazard) // if there is a block but it is not solid or a hazard
-				{
-					if (adjacent2 != nullptr && (adjacent2->m_solid || !adjacent2->m_hazard)) // if there is a safe, solid block behind
-						m_hspd *= -1; // reverse direction
-				}
 				m_flip = (m_hspd < 0); // flip sprite according to speed
 			}
-			// protects the snake from removal from the update queue if still on screen
-			if (abs(m_x - p->getx() - (320 - p->v_x)) < viewRangeH * 32 && abs(m_y - p->gety() - (320 - p->v_y)) < viewRangeV * 32)
-				m_protected = true;
-			else
-				m_protected = false;
-
 			SDL_Rect vrect{ p->v_x + m_x - p->getx() - 8, p->v_y + m_y - p->gety(), 32, 32 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, static_cast<SDL_RendererFlip>(m_flip));
+			drawSprite(ren, m_imageSet[m_frame], vrect, static_cast<SDL_RendererFlip>(m_flip));
 		}
 		else
 			m_protected = false; // don't protect the snakes update queue position if it is dead
 	}
-	virtual void action()
+	virtual void sync(Snapshot &s) override
 	{
-		g_score += 50; // add score on death
+		Object::sync(s);
+		s.sync(m_hspd);
+		s.sync(m_flip);
 	}
 };
-std::vector<SDL_Texture*> Snake::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Snake::m_imageSet{ tileImages[TILE_SNAKE] };
+
+
+// the tick an enemy's next action is due at, so that it sleeps until then rather than working out every frame whether a timer has
+// come round. A sleeping enemy's behaviour costs a comparison per frame, and as plain data it is snapshotted along with the rest.
+struct Wakeup
+{
+	int tick{ -1 }; // -1 while not sleeping
+	bool sleeping() { return tick != -1; }
+	bool due() { return tick != -1 && g_count >= tick; }
+	void sleep(int ticks) { tick = g_count + ticks; }
+	void cancel() { tick = -1; }
+};
 
 
 // pterodactyl enemey that flies back and forth over a fixed distance
 class Ptero : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_turn; // the next reversal
 	int m_interval{ 80 }; // flight interval
 	double m_acc{ -0.125 };
 	double m_hspd{ m_interval/2 * m_acc };
 	bool m_flip{ 0 };
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Ptero(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, false, true, true, false)
+		Object(x, y, TILE_PTERO)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
-			if (m_timerBase == -1) // sets reference point to time from
-				m_timerBase = g_count;
-			if ((g_count - m_timerBase) % m_interval == 0) // reverse at correct time
+			if (!m_turn.sleeping() || m_turn.due()) // reverse on the first frame and every interval after
+			{
 				m_acc *= -1;
+				m_turn.sleep(m_interval);
+			}
 			if (g_count % 10 == 0) // flap wings every 10 frames
 				m_frame = (m_frame + 1) % 2;
 			m_hspd += m_acc; // accelerate
@@ -766,23 +2638,19 @@ public:
 			if (m_hspd != 0)
 				m_x += floor(abs(m_hspd)) * m_hspd / abs(m_hspd); // update position
 			m_rect = { m_x, m_y, m_rect.w, m_rect.h }; // update rect
+			if (level.alignTiles(m_rect, m_hspd / abs(m_hspd), 0, true))
+				m_hspd = 0;
 			for (int i{ 0 }; i < solids->size(); i++) // check for collisions with solids
 				if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0))
 					m_hspd = 0;
 			m_flip = (m_hspd < 0); // flip sprite depending on speed
-			// deals with protections
-			if (abs(m_x - p->getx() - (320 - p->v_x)) < viewRangeH * 32 && abs(m_y - p->gety() - (320 - p->v_y)) < viewRangeV * 32)
-				m_protected = true;
-			else
-				m_protected = false;
-
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, static_cast<SDL_RendererFlip>(m_flip));
+			drawSprite(ren, m_imageSet[m_frame], vrect, static_cast<SDL_RendererFlip>(m_flip));
 		}
 		else
 		{
 			m_protected = false;
-			m_timerBase = -1;
+			m_turn.cancel();
 		}
 	}
 	virtual void reset()
@@ -790,7 +2658,7 @@ public:
 		m_x = m_startx;
 		m_y = m_starty;
 		m_exists = true;
-		m_timerBase = -1;
+		m_turn.cancel();
 		m_acc = -abs(m_acc);
 		m_hspd = m_interval / 2 * m_acc;
 	}
@@ -798,28 +2666,32 @@ public:
 	{
 		this->reset();
 	}
-	virtual void action()
+	virtual void sync(Snapshot &s) override
 	{
-		g_score += 100;
+		Object::sync(s);
+		s.sync(m_turn);
+		s.sync(m_acc);
+		s.sync(m_hspd);
+		s.sync(m_flip);
 	}
 };
-std::vector<SDL_Texture*> Ptero::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Ptero::m_imageSet{ tileImages[TILE_PTERO] };
 
 
 // frog enemy that jumps towards the player
 class Frog : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_jump; // the next jump, taken only if on the ground then
 	double m_hspd = 0;
 	double m_vspd = 0;
 	bool m_grounded{ true };
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Frog(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, false, true, true, false) // 16, 32
+		Object(x, y, TILE_FROG)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_exists)
 		{
@@ -829,26 +2701,26 @@ public:
 		if (m_exists)
 		{
 			m_rect.y += 1;
-			m_grounded = false; // stores whether the frog if on the ground
+			m_grounded = (level.touching(m_rect, true) != nullptr); // stores whether the frog if on the ground
 			for (Object *solid : *solids) // check for solid blocks underneath
 			{
 				if (collided(m_rect, solid->getRect()))
 					m_grounded = true;
 			}
 			m_rect.y -= 1;
-			if (m_timerBase == -1) // sets a timing reference point
-				m_timerBase = g_count;
-			else if ((g_count - m_timerBase) % 50 == 0 && m_grounded) // if time up and on the ground
-			{
-				m_timerBase = -1; // reset timer
-				// move on a trajectory onto the player
-				double x = m_x - p->getx() - 16;
-				double y = m_y - p->gety() - 16;
-				double dir = atan((pow(10, 2) + sqrt(pow(10, 4) - 0.3*(0.3*pow(x, 2) + 2 * y*pow(10, 2)))) / (0.3 * x));
-				if (!isnan(dir))
+			if (!m_jump.sleeping()) // wait 50 frames from landing
+				m_jump.sleep(50);
+			else if (m_jump.due() && !m_grounded) // still in the air, so try again in another 50
+				m_jump.sleep(50);
+			else if (m_jump.due()) // if time up and on the ground
+			{
+				m_jump.cancel();
+				// move on a trajectory onto the player, if it can reach them
+				Aim aim{ g_ballistics.aim(m_x, m_y, p->getx() + 16, p->gety() + 16) };
+				if (aim.reachable)
 				{
-					m_hspd = -(x / abs(x)) * 10 * cos(dir);
-					m_vspd = -(x / abs(x)) * 10 * sin(dir);
+					m_hspd = aim.hspd;
+					m_vspd = aim.vspd;
 					m_grounded = false;
 				}
 			}
@@ -859,6 +2731,9 @@ public:
 			m_x += m_hspd; // update x position
 			m_rect = { m_x, m_y, 32, 32 }; // update collision rect
 			// performs horizontal collision checks/allignments
+			if (level.alignTiles(m_rect, m_hspd / abs(m_hspd), 0, true))
+				m_hspd *= -1;
+			m_x = m_rect.x;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0))
@@ -870,20 +2745,21 @@ public:
 			m_y += m_vspd; // update y position
 			m_rect = { m_x, m_y, 32, 32 }; // update collision rect
 			// performs vertical collision checks/allignments
+			if (level.alignTiles(m_rect, 0, m_vspd / abs(m_vspd), true))
+			{
+				m_vspd = 0;
+				m_jump.cancel();
+			}
+			m_y = m_rect.y;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), 0, m_vspd / abs(m_vspd)))
 				{
 					m_vspd = 0;
-					m_timerBase = -1;
+					m_jump.cancel();
 				}
 				m_y = m_rect.y;
 			}
-			// protects the frog on screen
-			if (abs(m_x - p->getx() - (320 - p->v_x)) < viewRangeH * 32 && abs(m_y - p->gety() - (320 - p->v_y)) < viewRangeV * 32)
-				m_protected = true;
-			else
-				m_protected = false;
 			// gets correct sprite + direction to face
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
 			SDL_RendererFlip flip = SDL_FLIP_NONE;
@@ -891,7 +2767,7 @@ public:
 				flip = static_cast<SDL_RendererFlip>((m_x > p->getx()));
 			else
 				flip = static_cast<SDL_RendererFlip>((m_hspd < 0));
-			SDL_RenderCopyEx(ren, m_imageSet[abs(m_grounded - 1)], NULL, &vrect, 0, NULL, flip);
+			drawSprite(ren, m_imageSet[abs(m_grounded - 1)], vrect, flip);
 		}
 	}
 	virtual void reset()
@@ -900,16 +2776,20 @@ public:
 		m_y = m_starty;
 		m_rect = { m_x, m_y, 32, 32 };
 		m_exists = true;
-		m_timerBase = -1;
+		m_jump.cancel();
 		m_hspd = 0;
 		m_vspd = 0;
 	}
-	virtual void action()
+	virtual void sync(Snapshot &s) override
 	{
-		g_score += 100;
+		Object::sync(s);
+		s.sync(m_jump);
+		s.sync(m_hspd);
+		s.sync(m_vspd);
+		s.sync(m_grounded);
 	}
 };
-std::vector<SDL_Texture*> Frog::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Frog::m_imageSet{ tileImages[TILE_FROG] };
 
 
 // spore projectile launched by plant enemies
@@ -923,19 +2803,25 @@ public:
 	Spore(int x, int y, double hspd, double vspd, SDL_Renderer *ren, std::vector<Object*> *hazards) :
 		Object(x + 8, y + 8, 16, 16, false, true, false, false), m_hspd{ hspd }, m_vspd{ vspd }
 	{
-		hazards->push_back(static_cast<Object*>(this));
+		if (hazards) // (not given when restored from a snapshot, it adds itself on its next update)
+			addHazard(hazards, this);
 	}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
-			Object *temp = static_cast<Object*>(this); // gets an Object pointer for the spore
-			if (getIndex(hazards, temp) == -1) // checks hazards for this Object pointer
-				hazards->push_back(temp); // adds it if its not there
+			if (!isHazard(hazards, this)) // checks hazards for this object
+				addHazard(hazards, this); // adds it if its not there
 			m_vspd += 0.3; // accelerate
 			m_x += m_hspd; // update x position
 			m_rect = { m_x, m_y, 16, 16 }; // update collision rect
 			// performs horizontal collision checks/allignments
+			if (level.alignTiles(m_rect, m_hspd / abs(m_hspd), 0, true))
+			{
+				m_hspd = 0;
+				cleanup(hazards); // safely deletes self and removes from groups
+			}
+			m_x = m_rect.x;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0))
@@ -948,6 +2834,12 @@ public:
 			m_y += m_vspd;
 			m_rect = { m_x, m_y, 16, 16 };
 			// performs vertical collision checks/allignments
+			if (level.alignTiles(m_rect, 0, m_vspd / abs(m_vspd), true))
+			{
+				m_vspd = 0;
+				cleanup(hazards); // safely deletes self and removes from groups
+			}
+			m_y = m_rect.y;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), 0, m_vspd / abs(m_vspd)))
@@ -957,20 +2849,25 @@ public:
 				}
 				m_y = m_rect.y;
 			}
-			if (m_y > static_cast<int>(level.size() * 32)) // if outside level range
+			if (m_y > level.height() * 32) // if outside level range
 			{
 				cleanup(hazards); // safely deletes self and removes from groups
 			}
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 16, 16 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE);
+			drawSprite(ren, m_imageSet[m_frame], vrect);
 		}
 	}
 	void cleanup(std::vector<Object*> *hazards) // removes from active hazards, always does this before plant deletes the full spore object
 	{
 		m_exists = false;
-		Object *ptr = static_cast<Object*>(this);
-		if (getIndex(hazards, ptr) != -1)
-			hazards->erase(hazards->begin() + getIndex(hazards, ptr));
+		if (isHazard(hazards, this))
+			removeHazard(hazards, this);
+	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_hspd);
+		s.sync(m_vspd);
 	}
 };
 std::vector<SDL_Texture*> Spore::m_imageSet{ 0 };
@@ -987,18 +2884,24 @@ public:
 	Snowball(int x, int y, double hspd, double vspd, SDL_Renderer *ren, std::vector<Object*> *hazards) :
 		Object(x + 8, y + 8, 16, 16, false, true, false, false), m_hspd{ hspd }, m_vspd{ vspd }
 	{
-		hazards->push_back(static_cast<Object*>(this));
+		if (hazards) // (not given when restored from a snapshot, it adds itself on its next update)
+			addHazard(hazards, this);
 	}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
-			Object *temp = static_cast<Object*>(this); // sets the this pointer to an object pointer
-			if (getIndex(hazards, temp) == -1) // checks hazards for this changed pointer
-				hazards->push_back(temp); // adds it if its not there
+			if (!isHazard(hazards, this)) // checks hazards for this object
+				addHazard(hazards, this); // adds it if its not there
 			m_x += m_hspd; // update x position
 			m_rect = { m_x, m_y, 16, 16 }; // update collision rect
-										   // performs horizontal collision checks/allignments
+			// performs horizontal collision checks/allignments
+			if (level.alignTiles(m_rect, m_hspd / abs(m_hspd), 0, true))
+			{
+				m_hspd = 0;
+				cleanup(hazards); // safely deletes self and removes from groups
+			}
+			m_x = m_rect.x;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0))
@@ -1011,6 +2914,12 @@ public:
 			m_y += m_vspd;
 			m_rect = { m_x, m_y, 16, 16 };
 			// performs vertical collision checks/allignments
+			if (level.alignTiles(m_rect, 0, m_vspd / abs(m_vspd), true))
+			{
+				m_vspd = 0;
+				cleanup(hazards); // safely deletes self and removes from groups
+			}
+			m_y = m_rect.y;
 			for (int i{ 0 }; i < solids->size(); i++)
 			{
 				if (align(m_rect, solids->at(i)->getRect(), 0, m_vspd / abs(m_vspd)))
@@ -1020,48 +2929,69 @@ public:
 				}
 				m_y = m_rect.y;
 			}
-			if (m_y > static_cast<int>(level.size() * 32)) // if outside level range
+			if (m_y > level.height() * 32) // if outside level range
 				cleanup(hazards); // safely deletes self and removes from groups
-			if (m_x > static_cast<int>(level.at(0).size()) * 32 || m_x < 0)
+			if (m_x > level.width() * 32 || m_x < 0)
 				cleanup(hazards);
 			if (p->v_x + m_x - p->getx() < -8 || p->v_x + m_x - p->getx() > 648)
 				cleanup(hazards);
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 16, 16 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE);
+			drawSprite(ren, m_imageSet[m_frame], vrect);
 		}
 	}
 	void cleanup(std::vector<Object*> *hazards)
 	{
 		m_exists = false;
-		Object *ptr = static_cast<Object*>(this);
-		if (getIndex(hazards, ptr) != -1)
-			hazards->erase(hazards->begin() + getIndex(hazards, ptr));
+		if (isHazard(hazards, this))
+			removeHazard(hazards, this);
+	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_hspd);
+		s.sync(m_vspd);
 	}
 };
 std::vector<SDL_Texture*> Snowball::m_imageSet{ 0 };
 
 
+// passes a shooter's projectiles through a snapshot as their number and then each one's state, making or deleting projectiles of
+// type T while loading so that there are as many as were saved
+template <typename T>
+void syncProjectiles(Snapshot &s, std::vector<Object*> &projectiles)
+{
+	int count{ s.syncCount(projectiles.size()) };
+	if (s.loading())
+	{
+		for (; projectiles.size() > count; projectiles.pop_back())
+			delete projectiles.back();
+		while (projectiles.size() < count)
+			projectiles.push_back(new T(0, 0, 0, 0, nullptr, nullptr));
+	}
+	for (Object *ptr : projectiles)
+		ptr->sync(s);
+}
+
+
 // plant enemy that fires three spores
 class Plant : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_fire;
 	std::vector<Object*> m_spores;
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Plant(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, false, false, false, false)
+		Object(x, y, TILE_PLANT)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_exists) // this corrects enemy behaviour which doesn't apply to the plant
 			m_exists = true;
 
-		if (m_timerBase == -1) // sets a reference to time from
-			m_timerBase = g_count;
-
-		if ((g_count - m_timerBase) % 150 == 0) // every 150 frames
+		if (!m_fire.sleeping() || m_fire.due()) // on the first frame and every 150 after
 		{
+			m_fire.sleep(150);
 			// create three spores and store them
 			Object* spore1 = new Spore(m_x, m_y, -3, -10, ren, hazards);
 			Object* spore2 = new Spore(m_x, m_y, 0, -10, ren, hazards);
@@ -1086,16 +3016,22 @@ public:
 			}
 		}
 		SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-		SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE);
+		drawSprite(ren, m_imageSet[m_frame], vrect);
 	}
 	virtual void reset()
 	{
 		m_exists = true;
-		m_timerBase = -1;
+		m_fire.cancel();
 		for (Object *spore : m_spores)
 			delete spore;
 		m_spores.clear();
 	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_fire);
+		syncProjectiles<Spore>(s, m_spores);
+	}
 	~Plant()
 	{
 		for (int i{ 0 }; i < m_spores.size(); i++)
@@ -1104,44 +3040,41 @@ public:
 		}
 	}
 };
-std::vector<SDL_Texture*> Plant::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Plant::m_imageSet{ tileImages[TILE_PLANT] };
 
 
 // plant enemy that fires spores at the player and hides when approached
 class Spit : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_fire;
 	int m_shake{ -1 };
 	std::vector<Object*> m_spores;
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Spit(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, false, false, false, false)
+		Object(x, y, TILE_SPIT)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_exists) // corrects unwanted grouped enemy behaviour
 			m_exists = true;
 		SDL_RendererFlip flip{ SDL_FLIP_NONE };
-		double pdist = sqrt(pow(m_x - p->getx() - 16, 2) + pow(m_y - p->gety(), 2)); // gets distance to player
-		if (pdist < 272 && pdist > 64) // if in range
+		if (m_playerDist2 < 272 * 272 && m_playerDist2 > 64 * 64) // if in range
 		{
 			if (m_shake == 5) // if finished shaking
 			{
-				if (m_timerBase == -1)
-					m_timerBase = g_count + 5; // set timing reference point
+				if (!m_fire.sleeping())
+					m_fire.sleep(5); // first shot 5 frames after standing up
 				m_frame = 1; // stand up
 				flip = static_cast<SDL_RendererFlip>((p->getx() > m_x)); // make sprite face player
-				if ((g_count - m_timerBase) % 40 == 0) // shoot spore at player
+				if (m_fire.due()) // shoot spore at player, then every 40 frames
 				{
-					// implementation of the trajectory equation
-					double x = m_x - p->getx() - 16;
-					double y = m_y - p->gety() - 16;
-					double dir = atan((pow(10, 2) + sqrt(pow(10, 4) - 0.3*(0.3*pow(x, 2) + 2 * y*pow(10, 2)))) / (0.3 * x));
-					if (!isnan(dir))
+					m_fire.sleep(40);
+					Aim aim{ g_ballistics.aim(m_x, m_y, p->getx() + 16, p->gety() + 16) };
+					if (aim.reachable)
 					{
-						Object* spore = new Spore(m_x, m_y, -(x / abs(x)) * 10 * cos(dir), -(x / abs(x)) * 10 * sin(dir), ren, hazards);
+						Object* spore = new Spore(m_x, m_y, aim.hspd, aim.vspd, ren, hazards);
 						m_spores.push_back(spore);
 					}
 				}
@@ -1151,7 +3084,7 @@ public:
 		}
 		else // if not in range hide again
 		{
-			m_timerBase = -1;
+			m_fire.cancel();
 			m_frame = 0;
 			m_shake = -1;
 		}
@@ -1173,18 +3106,25 @@ public:
 			shake = -1 + 2 * (m_shake % 2 == 0);
 		SDL_Rect vrect{ p->v_x + m_x - p->getx() + shake, p->v_y + m_y - p->gety(), 32, 32 };
 			
-		SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, flip);
+		drawSprite(ren, m_imageSet[m_frame], vrect, flip);
 	}
 	virtual void reset()
 	{
 		m_exists = true;
-		m_timerBase = -1;
+		m_fire.cancel();
 		for (int i{ 0 }; i < m_spores.size(); i++)
 		{
 			delete m_spores[i];
 		}
 		m_spores.clear();
 	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_fire);
+		s.sync(m_shake);
+		syncProjectiles<Spore>(s, m_spores);
+	}
 	~Spit()
 	{
 		for (int i{ 0 }; i < m_spores.size(); i++)
@@ -1193,21 +3133,21 @@ public:
 		}
 	}
 };
-std::vector<SDL_Texture*> Spit::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Spit::m_imageSet{ tileImages[TILE_SPIT] };
 
 
 // *WORLD 2* yeti enemy
 class Yeti : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_fire;
 	std::vector<Object*> m_snowballs;
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Yeti(int x, int y, SDL_Renderer *ren) :
-		Object(x, y, 32, 32, false, true, true, false)
+		Object(x, y, TILE_YETI)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		for (int i{ 0 }; i < m_snowballs.size(); i++) // spore updating
 		{
@@ -1221,33 +3161,31 @@ public:
 		if (m_exists)
 		{
 			SDL_RendererFlip flip{ SDL_FLIP_NONE };
-			double pdist = sqrt(pow(m_x - p->getx() - 16, 2) + pow(m_y - p->gety(), 2)); // gets distance to player
-			if (pdist < 272) // if in range
+			if (m_playerDist2 < 272 * 272) // if in range
 			{
-				if (m_timerBase == -1)
-					m_timerBase = g_count; // set timing reference point
 				flip = static_cast<SDL_RendererFlip>((p->getx() < m_x)); // make sprite face player
-				if ((g_count - m_timerBase) % 100 == 0) // shoot snowball at player
+				if (!m_fire.sleeping() || m_fire.due()) // shoot snowball at player on coming into range and every 100 frames after
 				{
+					m_fire.sleep(100);
 					double dir = atan2(m_y - p->gety(), m_x - p->getx());
 					Object* snowball = new Snowball(m_x, m_y, -8 * cos(dir), -8 * sin(dir), ren, hazards);
 					m_snowballs.push_back(snowball);
 				}
 			}
 			else
-				m_timerBase = -1;
+				m_fire.cancel();
 			if (m_snowballs.size() != 0)
 				m_protected = true;
 			else
 				m_protected = false;
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 32, 32 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, flip);
+			drawSprite(ren, m_imageSet[m_frame], vrect, flip);
 		}
 	}
 	virtual void reset()
 	{
 		m_exists = true;
-		m_timerBase = -1;
+		m_fire.cancel();
 		for (int i{ 0 }; i < m_snowballs.size(); i++)
 			delete m_snowballs[i];
 		m_snowballs.clear();
@@ -1256,64 +3194,75 @@ public:
 	{
 		reset();
 	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_fire);
+		syncProjectiles<Snowball>(s, m_snowballs);
+	}
 	~Yeti()
 	{
 		for (int i{ 0 }; i < m_snowballs.size(); i++)
 			delete m_snowballs[i];
 	}
 };
-std::vector<SDL_Texture*> Yeti::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Yeti::m_imageSet{ tileImages[TILE_YETI] };
 
 
 // mushroom that player can bounce on
 class Mushroom : public Object
 {
 private:
-	int m_timerBase{ -1 };
+	Wakeup m_recover; // when it springs back up after being bounced on
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Mushroom(int x, int y, SDL_Renderer *ren) :
-		Object(x, y + 4, 32, 28, false, false, true, false)
+		Object(x, y, TILE_MUSHROOM)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_exists) // if player bounced on it
 		{
 			m_exists = true; // make it exist again
 			m_frame = 1; // set to squished sprite
-			m_timerBase = g_count; // start counting
+			m_recover.sleep(10);
 		}
 		if (m_exists)
 		{
-			if (m_timerBase != -1 && g_count - m_timerBase == 10) // if 10 frames have passed while counting
+			if (m_recover.due())
 			{
 				m_frame = 0; // return to normal sprite
-				m_timerBase = -1; // stop counting
+				m_recover.cancel();
 			}
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety() - 4, 32, 32 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE); // draw self
+			drawSprite(ren, m_imageSet[m_frame], vrect); // draw self
 		}
 	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_recover);
+	}
 };
-std::vector<SDL_Texture*> Mushroom::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Mushroom::m_imageSet{ tileImages[TILE_MUSHROOM] };
 
 
 // gem that gives 100 score
 class Gem100 : public Object
 {
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Gem100(int x, int y, SDL_Renderer *ren) :
-		Object(x + 8, y + 8, 16, 16, false, false, false, true)
+		Object(x, y, TILE_GEM100)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
 			if (g_count % 10 == 0)
 				m_frame = (m_frame + 1) % 2; // switch sprites every 10 frames
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 16, 16 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE);
+			drawSprite(ren, m_imageSet[m_frame], vrect);
 		}
 	}
 	virtual void reset() override // don't do anything on reset
@@ -1322,30 +3271,26 @@ public:
 	{
 		m_exists = true;
 	}
-	virtual void action()
-	{
-		g_score += 100; // give 100 points when picked up
-	}
 };
-std::vector<SDL_Texture*> Gem100::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &Gem100::m_imageSet{ tileImages[TILE_GEM100] };
 
 
 // gem that gives 1 life
 class GemL : public Object
 {
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	GemL(int x, int y, SDL_Renderer *ren) :
-		Object(x + 8, y + 8, 16, 16, false, false, false, true)
+		Object(x, y, TILE_GEML)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (m_exists)
 		{
 			if (g_count % 10 == 0) // rotation animation
 				m_frame = (m_frame + 1) % 2;
 			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety(), 16, 16 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, SDL_FLIP_NONE);
+			drawSprite(ren, m_imageSet[m_frame], vrect);
 		}
 	}
 	virtual void reset() override
@@ -1359,7 +3304,7 @@ public:
 		g_lives += 1;
 	}
 };
-std::vector<SDL_Texture*> GemL::m_imageSet{ 0 };
+std::vector<SDL_Texture*> &GemL::m_imageSet{ tileImages[TILE_GEML] };
 
 
 // *WORLD 2* mammoth enemy
@@ -1368,12 +3313,13 @@ class Mammoth : public Object
 private:
 	double m_hspd{ 1 };
 	bool m_flip{ 0 };
+	PatrolSpan m_span;
 public:
-	static std::vector<SDL_Texture*>m_imageSet;
+	static std::vector<SDL_Texture*> &m_imageSet;
 	Mammoth(int x, int y, SDL_Renderer *ren) :
-		Object(x, y + 18, 64, 44, false, true, true, false) // 16, 32
+		Object(x, y, TILE_MAMMOTH)
 	{}
-	virtual void update(SDL_Renderer *ren, std::vector<std::vector<Object*>> &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
+	virtual void update(SDL_Renderer *ren, Level &level, Player *p, std::vector<Object*> *solids, std::vector<Object*> *hazards) override
 	{
 		if (!m_exists)
 			m_exists = true;
@@ -1382,15 +3328,12 @@ public:
 			if (g_count % 10 == 0)
 				m_frame = (m_frame + 1) % 2; // advance animation to next frame
 			m_x += m_hspd; // move forward
+			int turn{ m_span.clamp(level, m_rect, m_x, true) };
+			if (turn) // turn around at walls, static hazards and ledges
+				m_hspd = turn * fabs(m_hspd);
 			m_rect = { m_x, m_y, m_rect.w, m_rect.h}; // update collision rect
 			int start = m_hspd;
-			for (int i{ 0 }; i < solids->size(); i++) // check for horizontal collisions
-			{
-				if (align(m_rect, solids->at(i)->getRect(), m_hspd / abs(m_hspd), 0)) // if a collision found
-					m_hspd = -start; // reverse direction
-				m_x = m_rect.x;
-			}
-			for (int i{ 0 }; i < hazards->size(); i++) // check for horizontal collisions
+			for (int i{ 0 }; i < hazards->size(); i++) // other hazards move, so are still checked against
 			{
 				if (hazards->at(i) == this)
 					continue;
@@ -1398,390 +3341,967 @@ public:
 					m_hspd = -start; // reverse direction
 				m_x = m_rect.x;
 			}
-			// get the two objects on either side and below the mammoth
-			Object *adjacent1 = level[(m_y + 16) / 32 + 1][(m_x - 1 + 32 + 32 * m_hspd / abs(m_hspd)) / 32];
-			Object *adjacent2 = level[(m_y + 16) / 32 + 1][(m_x + 1 - 32 * m_hspd / abs(m_hspd)) / 32];
-			if (adjacent1 == nullptr) // if empty space on one side
+			m_flip = (m_hspd < 0);
+			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety() - 2, 64, 48 };
+			drawSprite(ren, m_imageSet[m_frame], vrect, static_cast<SDL_RendererFlip>(m_flip));
+		}
+		else
+			m_protected = false;
+	}
+	virtual void sync(Snapshot &s) override
+	{
+		Object::sync(s);
+		s.sync(m_hspd);
+		s.sync(m_flip);
+	}
+};
+std::vector<SDL_Texture*> &Mammoth::m_imageSet{ tileImages[TILE_MAMMOTH] };
+
+
+
+
+
+
+// ---------------WEATHER---------------
+
+// rain as a fixed pool of falling drops, each drawn as a thin solid rect and all of them in one call, so only the drops are filled
+// rather than blending whole screens of rain over the level
+class Rain
+{
+private:
+	static constexpr int m_capacity{ 1024 };
+	// each property of the drops is its own array so that moving them is a tight loop
+	float m_x[m_capacity];
+	float m_y[m_capacity];
+	float m_speed[m_capacity];
+	SDL_Rect m_rects[m_capacity];
+	int m_active{ 0 }; // the first m_active drops of the pool are falling
+	int m_lastView{ 0 }; // left edge of the view last frame, the drops are moved against it so they scroll with the level
+	bool m_viewed{ false }; // m_lastView has been set
+	void spawn(int i, float y)
+	{
+		m_x[i] = rand() % screenw;
+		m_y[i] = y;
+		m_speed[i] = 10 + rand() % 6;
+	}
+public:
+	Rain()
+	{
+		setDensity(g_rainDensity);
+	}
+	// sets the fraction of the pool falling, from 0 to 1. Added drops start anywhere on screen so they don't arrive as a wave.
+	void setDensity(float density)
+	{
+		int active{ static_cast<int>(std::min(std::max(density, 0.0f), 1.0f) * m_capacity) };
+		for (int i{ m_active }; i < active; i++)
+			spawn(i, 64 + rand() % screenh);
+		m_active = active;
+	}
+	void update(int view)
+	{
+		float scroll{ m_viewed ? static_cast<float>((view - m_lastView) % screenw) : 0.0f }; // whole screens make no difference
+		m_lastView = view;
+		m_viewed = true;
+		for (int i{ 0 }; i < m_active; i++)
+		{
+			m_x[i] -= scroll;
+			m_y[i] += m_speed[i];
+		}
+		for (int i{ 0 }; i < m_active; i++)
+		{
+			if (m_y[i] >= screenh + 64) // fell off the bottom, so falls again from the top
+				spawn(i, m_y[i] - screenh);
+			else if (m_x[i] < 0)
+				m_x[i] += screenw;
+			else if (m_x[i] >= screenw)
+				m_x[i] -= screenw;
+		}
+	}
+	void draw(SDL_Renderer *ren)
+	{
+		for (int i{ 0 }; i < m_active; i++)
+			m_rects[i] = { static_cast<int>(m_x[i]), static_cast<int>(m_y[i]), 1, static_cast<int>(m_speed[i]) };
+		SDL_SetRenderDrawColor(ren, 170, 190, 230, 255);
+		SDL_RenderFillRects(ren, m_rects, m_active);
+	}
+};
+
+
+
+
+
+
+// ---------------INTERFACE---------------
+
+
+// draws text as runs of quads from a texture atlas of the font's glyphs, which is rasterized once when the font is loaded. Changing
+// the text shown therefore never touches TTF or uploads a texture.
+class GlyphAtlas
+{
+private:
+	static const int m_first{ 32 }; // printable ascii range
+	static const int m_last{ 126 };
+	SDL_Texture *m_texture{ nullptr };
+	SDL_Rect m_glyphs[m_last - m_first + 1]; // where each glyph sits in the atlas
+	int m_advance[m_last - m_first + 1]; // how far each glyph moves the pen
+public:
+	// frees the atlas texture, must be called before the renderer is destroyed
+	void destroy()
+	{
+		g_resources.destroy(m_texture);
+		m_texture = nullptr;
+	}
+	// renders every glyph in white on black into one texture and records its metrics
+	bool build(SDL_Renderer *ren, TTF_Font *font)
+	{
+		std::vector<SDL_Surface*> surfaces;
+		int width{ 0 };
+		int height{ 0 };
+		for (int c{ m_first }; c <= m_last; c++)
+		{
+			SDL_Surface *glyph{ g_resources.track(TTF_RenderGlyph_Shaded(font, c, { 255, 255, 255 }, { 0, 0, 0 }), "text", "glyph") };
+			int advance{ 0 };
+			TTF_GlyphMetrics(font, c, NULL, NULL, NULL, NULL, &advance);
+			m_glyphs[c - m_first] = { width, 0, glyph ? glyph->w : 0, glyph ? glyph->h : 0 };
+			m_advance[c - m_first] = advance;
+			if (glyph)
 			{
-				if (adjacent2 != nullptr)
-					m_hspd *= -1; // reverse direction
+				width += glyph->w;
+				height = std::max(height, glyph->h);
 			}
-			else if (!adjacent1->m_solid || adjacent1->m_hazard) // if both non solid or hazards
+			surfaces.push_back(glyph);
+		}
+		SDL_Surface *atlas{ g_resources.track(SDL_CreateRGBSurfaceWithFormat(0, std::max(width, 1), std::max(height, 1), 32, g_format), "text",
+			"glyph atlas") };
+		for (int i{ 0 }; i < surfaces.size(); i++)
+			if (surfaces[i])
 			{
-				if (adjacent2 != nullptr && (adjacent2->m_solid || !adjacent2->m_hazard))
-					m_hspd *= -1; // reverse direction
+				SDL_BlitSurface(surfaces[i], NULL, atlas, &m_glyphs[i]);
+				g_resources.destroy(surfaces[i]);
 			}
-			m_flip = (m_hspd < 0);
-			// protects the mammoth if still on screen
-			if (abs(m_x - p->getx() - (320 - p->v_x)) < (viewRangeH + 2) * 32 && abs(m_y - p->gety() - (320 - p->v_y)) < viewRangeV * 32)
-				m_protected = true;
-			else
-				m_protected = false;
+		m_texture = g_resources.track(SDL_CreateTextureFromSurface(ren, atlas), "text", "glyph atlas");
+		g_resources.destroy(atlas);
+		return m_texture != nullptr;
+	}
+	// draws text with its top left corner at (x, y) and returns its width
+	int draw(SDL_Renderer *ren, const char *text, int x, int y)
+	{
+		int pen{ x };
+		for (const char *c{ text }; *c; c++)
+		{
+			if (*c < m_first || *c > m_last)
+				continue;
+			SDL_Rect &src{ m_glyphs[*c - m_first] };
+			SDL_Rect dst{ pen, y, src.w, src.h };
+			SDL_RenderCopy(ren, m_texture, &src, &dst);
+			pen += m_advance[*c - m_first];
+		}
+		return pen - x;
+	}
+};
 
-			SDL_Rect vrect{ p->v_x + m_x - p->getx(), p->v_y + m_y - p->gety() - 2, 64, 48 };
-			SDL_RenderCopyEx(ren, m_imageSet[m_frame], NULL, &vrect, 0, NULL, static_cast<SDL_RendererFlip>(m_flip));
+// the strip along the top of the screen with the score and lives, kept in a texture of its own that is only redrawn when
+// either changes so most frames cost a single copy
+class Hud
+{
+private:
+	static const int m_height{ 64 };
+	static const int m_border{ 2 }; // width of the white line along the bottom
+	SDL_Texture *m_texture{ nullptr };
+	bool m_target{ true }; // false once the renderer has refused a render target, the strip is then drawn directly
+	int m_score{ -1 }; // values the cached strip shows
+	int m_lives{ -1 };
+	// draws the border, score and lives onto whatever the renderer currently targets
+	void compose(SDL_Renderer *ren, GlyphAtlas &text)
+	{
+		const SDL_Rect outer{ 0, 0, screenw, m_height };
+		const SDL_Rect inner{ 0, 0, screenw, m_height - m_border };
+		char score[32];
+		char lives[32];
+		snprintf(score, sizeof(score), "SCORE  %07d", g_score); // zero padded to 7 digits
+		snprintf(lives, sizeof(lives), "LIVES  %02d", g_lives);
+
+		SDL_SetRenderDrawColor(ren, 255, 255, 255, 255); // draw in white
+		SDL_RenderFillRect(ren, &outer); // draw box on top of screen
+		SDL_SetRenderDrawColor(ren, 0, 0, 0, 255); // draw in black
+		SDL_RenderFillRect(ren, &inner); // fill in majority of the first box
+		text.draw(ren, score, 40, 10);
+		text.draw(ren, lives, 450, 10);
+	}
+public:
+	// makes the texture the strip is cached in, otherwise made when it is first drawn
+	void build(SDL_Renderer *ren)
+	{
+		if (m_texture || !m_target)
+			return;
+		m_texture = g_resources.track(SDL_CreateTexture(ren, g_format, SDL_TEXTUREACCESS_TARGET, screenw, m_height), "hud", "hud strip");
+		m_target = m_texture != nullptr;
+		invalidate();
+	}
+	// frees the cached strip, must be called before the renderer is destroyed
+	void destroy()
+	{
+		g_resources.destroy(m_texture);
+		m_texture = nullptr;
+		invalidate();
+	}
+	// forces a redraw next frame, for when the renderer has thrown away the contents of its targets
+	void invalidate()
+	{
+		m_score = -1;
+		m_lives = -1;
+	}
+	void draw(SDL_Renderer *ren, GlyphAtlas &text)
+	{
+		build(ren);
+		if (!m_texture)
+		{
+			compose(ren, text);
+			return;
+		}
+		if (g_score != m_score || g_lives != m_lives)
+		{
+			SDL_SetRenderTarget(ren, m_texture);
+			compose(ren, text);
+			SDL_SetRenderTarget(ren, NULL);
+			m_score = g_score;
+			m_lives = g_lives;
+		}
+		const SDL_Rect dst{ 0, 0, screenw, m_height };
+		SDL_RenderCopy(ren, m_texture, NULL, &dst);
+	}
+};
+
+
+// ---------------REGISTRY---------------
+
+
+// the factory for a dynamic type
+template <typename T>
+Object* spawn(int x, int y, SDL_Renderer *ren)
+{
+	return new T(x, y, ren);
+}
+
+
+// the registry of every type, indexed by TileType. Being constant data it is built into the program rather than at startup.
+const TileInfo tileInfo[TILE_COUNT]{
+	// spawn, static, solid, hazard, enemy, collectible, slide, traction, hitbox, score, protect range, serial, sprites
+	{ nullptr, false, false, false, false, false, false, 0.5, { 0, 0, 0, 0 }, 0, 0, false, &tileImages[TILE_EMPTY] },
+	{ nullptr, true, true, false, false, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_WALL] },
+	{ nullptr, true, false, true, false, false, false, 0.5, { 0, 3, 32, 29 }, 0, 0, false, &tileImages[TILE_WATER] },
+	{ nullptr, true, false, true, false, false, false, 0.5, { 0, 3, 32, 29 }, 0, 0, false, &tileImages[TILE_THORNS] },
+	{ nullptr, true, true, false, false, false, true, 0.1, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_ICE] },
+	{ spawn<ThinIce>, false, true, false, false, false, true, 0.1, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_THINICE] },
+	{ spawn<Gem100>, false, false, false, false, true, false, 0.5, { 8, 8, 16, 16 }, 100, 0, false, &tileImages[TILE_GEM100] },
+	{ spawn<GemL>, false, false, false, false, true, false, 0.5, { 8, 8, 16, 16 }, 0, 0, false, &tileImages[TILE_GEML] },
+	{ spawn<Snake>, false, false, true, true, false, false, 0.5, { 0, 0, 16, 32 }, 50, viewRangeH * 32, false, &tileImages[TILE_SNAKE] },
+	{ spawn<Ptero>, false, false, true, true, false, false, 0.5, { 0, 0, 32, 32 }, 100, viewRangeH * 32, false, &tileImages[TILE_PTERO] },
+	{ spawn<Plant>, false, false, false, false, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_PLANT] },
+	{ spawn<Spit>, false, false, false, false, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_SPIT] },
+	{ spawn<Mushroom>, false, false, false, true, false, false, 0.5, { 0, 4, 32, 28 }, 0, 0, false, &tileImages[TILE_MUSHROOM] },
+	{ spawn<Tree>, false, false, false, false, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_TREE] },
+	{ spawn<Flower>, false, false, false, false, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_FLOWER] },
+	{ spawn<Frog>, false, false, true, true, false, false, 0.5, { 0, 0, 32, 32 }, 100, viewRangeH * 32, false, &tileImages[TILE_FROG] },
+	{ spawn<Mammoth>, false, false, true, true, false, false, 0.5, { 0, 18, 64, 44 }, 50, (viewRangeH + 2) * 32, true, &tileImages[TILE_MAMMOTH] },
+	{ spawn<Yeti>, false, false, true, true, false, false, 0.5, { 0, 0, 32, 32 }, 0, 0, false, &tileImages[TILE_YETI] }
+};
+
+
+// the type each level file tile code stands for, one row per tileset. Adding a tileset only means adding a row here.
+const int tileSetCount{ 2 };
+const int tileCodeCount{ 14 };
+const Uint8 tileCodes[tileSetCount][tileCodeCount]{
+	{ TILE_EMPTY, TILE_WALL, TILE_WATER, TILE_THORNS, TILE_GEM100, TILE_GEML, TILE_SNAKE, TILE_PTERO, TILE_PLANT, TILE_SPIT, TILE_MUSHROOM,
+		TILE_TREE, TILE_FLOWER, TILE_FROG },
+	{ TILE_EMPTY, TILE_WALL, TILE_WATER, TILE_THORNS, TILE_GEM100, TILE_GEML, TILE_ICE, TILE_THINICE, TILE_MAMMOTH, TILE_YETI }
+};
+
+
+Uint8 tileTypeOf(int tileSet, int code)
+{
+	if (tileSet < 0 || tileSet >= tileSetCount || code < 0 || code >= tileCodeCount)
+		return TILE_EMPTY;
+	return tileCodes[tileSet][code];
+}
+
+
+
+
+
+
+// ------------------------------MAIN FUNCTIONS------------------------------
+
+// add an object into the correct groups based on its properties
+void groupInstance(Object* ptr, std::vector<Object*>& instances, std::vector<Object*>& solids, std::vector<Object*>& hazards, std::vector<Object*>& enemies, std::vector<Object*>& collectibles)
+{
+	instances.push_back(ptr); // push onto instances
+	if (ptr->m_solid)
+		solids.push_back(ptr);
+	if (ptr->m_hazard)
+		hazards.push_back(ptr);
+	if (ptr->m_enemy)
+		enemies.push_back(ptr);
+	if (ptr->m_collectible)
+		collectibles.push_back(ptr);
+}
+
+
+// reloads the active instances for the region about grid coordinate (gridx, gridy), keeping protected instances active
+void rebuildRegion(Level &level, int gridx, int gridy, std::vector<Object*> &protQueue, std::vector<Object*>& instances, std::vector<Object*>& solids,
+	std::vector<Object*>& hazards, std::vector<Object*>& enemies, std::vector<Object*>& collectibles)
+{
+	// instances which are no longer protected are treated like any other from here on, as streaming is free to evict them
+	protQueue.erase(std::remove_if(protQueue.begin(), protQueue.end(), [](Object *ptr) { return !ptr->m_protected; }), protQueue.end());
+	// reset instances which are leaving the region to perform normally if reloaded. This has to happen before streaming, which may
+	// free the chunks they belong to.
+	for (Object *instance : instances)
+	{
+		int x{ instance->m_startx / 32 };
+		int y{ instance->m_starty / 32 };
+		bool inRegion{ x >= gridx - viewRangeH && x <= gridx + viewRangeH && y >= gridy - viewRangeV && y <= gridy + viewRangeV };
+		if (!inRegion && getIndex(&protQueue, instance) == -1)
+			instance->reset();
+	}
+	// empty previous active instances
+	instances.clear(); 
+	// bring the chunks around the new region into memory before reading from it
+	level.stream(gridx);
+	solids.clear();
+	hazards.clear();
+	enemies.clear();
+	collectibles.clear();
+	// get the objects in the region with size viewRange about the new grid coordinate, static terrain is read from the tile map instead
+	std::vector<Object*> region;
+	level.objectsIn(gridx - viewRangeH, gridx + viewRangeH, gridy - viewRangeV, gridy + viewRangeV, region);
+	for (Object *ptr : region)
+	{
+		level.markDirty(ptr); // so a strong reset knows to reset it
+		groupInstance(ptr, instances, solids, hazards, enemies, collectibles); // sort the object into its groups
+	}
+	for (Object *ptr : protQueue) // for protected instances
+	{
+		if (getIndex(&instances, ptr) == -1) // if it wasn't loaded in
+		{
+			groupInstance(ptr, instances, solids, hazards, enemies, collectibles); // add it to the active instances
+		}
+	}
+}
+
+
+// measures every active instance against the player in one batch once the player has moved: each gets its squared distance from the
+// player, and those kept updating while on screen get their protection from the range test
+void updateProximity(std::vector<Object*>& instances, Player &player)
+{
+	static RectBatch positions;
+	static std::vector<int> ranges;
+	static std::vector<float> dist2;
+	static std::vector<Uint8> inRange;
+	positions.clear();
+	ranges.clear();
+	for (Object *ptr : instances)
+	{
+		positions.push({ ptr->getx(), ptr->gety(), 0, 0 });
+		ranges.push_back(tileInfo[ptr->getType()].protectRange);
+	}
+	// (the view centre is offset the same way the classes always measured it)
+	proximityKernel(player.getx() + 16, player.gety(), player.getx() + 320 - player.v_x, player.gety() + 320 - player.v_y, viewRangeV * 32,
+		positions, ranges, dist2, inRange);
+	for (int i{ 0 }; i < instances.size(); i++)
+	{
+		instances[i]->m_playerDist2 = dist2[i];
+		if (ranges[i])
+			instances[i]->m_protected = instances[i]->m_exists && inRange[i];
+	}
+}
+
+
+// updates the solid or the non-solid instances in order. Given worker threads and enough instances, runs of instances that don't read
+// each other are updated in parallel with their side effects deferred, then those are applied in instance order so that the outcome
+// is the same as updating them one after another. Serial types end a run and are updated on their own.
+void updateInstances(std::vector<Object*>& instances, bool solid, SDL_Renderer *ren, Level &level, Player &player, std::vector<Object*>& solids,
+	std::vector<Object*>& hazards)
+{
+	static std::vector<Object*> run;
+	static std::vector<Deferred> effects;
+	auto flush = [&]() {
+		if (run.size() < parallelMin || g_jobs.threads() == 1)
+		{
+			for (Object *ptr : run)
+				ptr->update(ren, level, &player, &solids, &hazards);
+		}
+		else
+		{
+			if (effects.size() < run.size())
+				effects.resize(run.size());
+			g_jobs.parallelFor(run.size(), parallelGrain, [&](int i) {
+				t_deferred = &effects[i];
+				run[i]->update(ren, level, &player, &solids, &hazards);
+				t_deferred = nullptr;
+			});
+			for (int i{ 0 }; i < run.size(); i++)
+				if (effects[i].apply(ren, &hazards))
+					level.terrainChanged();
+		}
+		run.clear();
+	};
+	for (Object *ptr : instances)
+	{
+		if (ptr->m_solid != solid)
+			continue;
+		if (tileInfo[ptr->getType()].serial)
+		{
+			flush();
+			ptr->update(ren, level, &player, &solids, &hazards);
 		}
 		else
-			m_protected = false;
+			run.push_back(ptr);
 	}
-	virtual void action()
+	flush();
+}
+
+
+// small print used by the profiler overlay
+static GlyphAtlas g_smallText;
+// score and lives strip drawn over the play area
+static Hud g_hud;
+
+
+// draws the profiler's rolling phase timings and last frame's counters over the top of the game
+void drawProfiler(SDL_Renderer *ren, Profiler &profiler)
+{
+	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(ren, 0, 0, 0, 192);
+	SDL_Rect back{ 0, 64, 360, 18 * (PHASE_COUNT + COUNTER_COUNT + 5) + 48 };
+	SDL_RenderFillRect(ren, &back);
+	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_NONE);
+	char line[64];
+	int y{ back.y + 2 };
+	g_smallText.draw(ren, profiler.recording() ? "PHASE   MIN   AVG   P99   MS   REC" : "PHASE   MIN   AVG   P99   MS", 4, y);
+	for (int i{ 0 }; i <= PHASE_COUNT; i++)
 	{
-		g_score += 50;
+		double min, avg, p99;
+		profiler.stats(i, &min, &avg, &p99);
+		y += 18;
+		g_smallText.draw(ren, i < PHASE_COUNT ? phaseNames[i] : "FRAME", 4, y);
+		snprintf(line, sizeof(line), "%6.2f %6.2f %6.2f", min, avg, p99);
+		g_smallText.draw(ren, line, 140, y);
 	}
-};
-std::vector<SDL_Texture*> Mammoth::m_imageSet{ 0 };
-
+	for (int i{ 0 }; i < COUNTER_COUNT; i++)
+	{
+		y += 18;
+		snprintf(line, sizeof(line), "%s  %d", counterNames[i], profiler.counter(static_cast<Counter>(i)));
+		g_smallText.draw(ren, line, 4, y);
+	}
+	double latency;
+	int worstLatency;
+	profiler.latencyStats(&latency, &worstLatency);
+	y += 18;
+	snprintf(line, sizeof(line), "INPUT TO SCREEN  %.1f  WORST  %d", latency, worstLatency);
+	g_smallText.draw(ren, line, 4, y);
+	y += 18;
+	snprintf(line, sizeof(line), "VRAM  %d KB  RAM  %d KB", static_cast<int>(g_resources.bytes(RESOURCE_TEXTURE) / 1024),
+		static_cast<int>((g_resources.bytes(RESOURCE_SURFACE) + g_resources.bytes(RESOURCE_CHUNK)) / 1024));
+	g_smallText.draw(ren, line, 4, y);
+
+	// frame time histogram from the pacer, a bar per millisecond scaled to the tallest
+	const int *histogram{ g_pacer.histogram() };
+	int most{ std::max(*std::max_element(histogram, histogram + g_pacer.bins()), 1) };
+	SDL_Rect bars[64];
+	for (int i{ 0 }; i < g_pacer.bins(); i++)
+	{
+		int h{ histogram[i] * 40 / most };
+		bars[i] = { 4 + i * 8, y + 62 - h, 7, h };
+	}
+	SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+	SDL_RenderFillRects(ren, bars, g_pacer.bins());
+}
 
 
+// loads the sprites used in play, setting the image set of every class
+void loadImages(SDL_Renderer *ren)
+{
+	Player::m_imageSet = {
+		g_resources.texture(ren, "sprites/player.png", "sprites"),
+		g_resources.texture(ren, "sprites/player1.png", "sprites"),
+		g_resources.texture(ren, "sprites/player2.png", "sprites")
+	};
+	tileImages[TILE_WALL] = {
+		g_resources.texture(ren, "sprites/wall1.png", "sprites"),
+		g_resources.texture(ren, "sprites/top1.png", "sprites"),
+		g_resources.texture(ren, "sprites/left1.png", "sprites"),
+		g_resources.texture(ren, "sprites/bottom1.png", "sprites"),
+		g_resources.texture(ren, "sprites/right1.png", "sprites"),
+		g_resources.texture(ren, "sprites/wall2.png", "sprites"),
+		g_resources.texture(ren, "sprites/top2.png", "sprites"),
+		g_resources.texture(ren, "sprites/left2.png", "sprites"),
+		g_resources.texture(ren, "sprites/bottom2.png", "sprites"),
+		g_resources.texture(ren, "sprites/right2.png", "sprites")
+	};
+	tileImages[TILE_WATER] = {
+		g_resources.texture(ren, "sprites/water1.png", "sprites"),
+		g_resources.texture(ren, "sprites/water2.png", "sprites"),
+		g_resources.texture(ren, "sprites/water3.png", "sprites")
+	};
+	tileImages[TILE_THORNS] = {
+		g_resources.texture(ren, "sprites/thorns.png", "sprites"),
+		g_resources.texture(ren, "sprites/icicle.png", "sprites")
+	};
+	tileImages[TILE_ICE] = {
+		g_resources.texture(ren, "sprites/iceTop.png", "sprites")
+	};
+	ThinIce::m_imageSet = {
+		g_resources.texture(ren, "sprites/iceThin1.png", "sprites"),
+		g_resources.texture(ren, "sprites/iceThin2.png", "sprites"),
+		g_resources.texture(ren, "sprites/iceThin3.png", "sprites"),
+		g_resources.texture(ren, "sprites/iceThin4.png", "sprites"),
+		g_resources.texture(ren, "sprites/water1.png", "sprites"),
+		g_resources.texture(ren, "sprites/water2.png", "sprites")
+	};
+	Tree::m_imageSet = {
+		g_resources.texture(ren, "sprites/tree1.png", "sprites"),
+		g_resources.texture(ren, "sprites/tree2.png", "sprites"),
+		g_resources.texture(ren, "sprites/tree3.png", "sprites")
+	};
+	Flower::m_imageSet = {
+		g_resources.texture(ren, "sprites/flower1.png", "sprites"),
+		g_resources.texture(ren, "sprites/flower2.png", "sprites")
+	};
+	Snake::m_imageSet = {
+		g_resources.texture(ren, "sprites/snake1.png", "sprites"),
+		g_resources.texture(ren, "sprites/snake2.png", "sprites")
+	};
+	Ptero::m_imageSet = {
+		g_resources.texture(ren, "sprites/ptero1.png", "sprites"),
+		g_resources.texture(ren, "sprites/ptero2.png", "sprites")
+	};
+	Frog::m_imageSet = {
+		g_resources.texture(ren, "sprites/frog1.png", "sprites"),
+		g_resources.texture(ren, "sprites/frog2.png", "sprites")
+	};
+	Spore::m_imageSet = {
+		g_resources.texture(ren, "sprites/spore.png", "sprites")
+	};
+	Snowball::m_imageSet = {
+		g_resources.texture(ren, "sprites/snowball.png", "sprites")
+	};
+	Plant::m_imageSet = {
+		g_resources.texture(ren, "sprites/plant1.png", "sprites")
+	};
+	Spit::m_imageSet = {
+		g_resources.texture(ren, "sprites/spit1.png", "sprites"),
+		g_resources.texture(ren, "sprites/spit2.png", "sprites")
+	};
+	Yeti::m_imageSet = {
+		g_resources.texture(ren, "sprites/yeti.png", "sprites")
+	};
+	Gem100::m_imageSet = {
+		g_resources.texture(ren, "sprites/gem1001.png", "sprites"),
+		g_resources.texture(ren, "sprites/gem1002.png", "sprites")
+	};
+	GemL::m_imageSet = {
+		g_resources.texture(ren, "sprites/gemL1.png", "sprites"),
+		g_resources.texture(ren, "sprites/gemL2.png", "sprites")
+	};
+	Mushroom::m_imageSet = {
+		g_resources.texture(ren, "sprites/mushroom1.png", "sprites"),
+		g_resources.texture(ren, "sprites/mushroom2.png", "sprites")
+	};
+	Mammoth::m_imageSet = {
+		g_resources.texture(ren, "sprites/mammoth1.png", "sprites"),
+		g_resources.texture(ren, "sprites/mammoth2.png", "sprites")
+	};
+	backgrounds.push_back(g_resources.texture(ren, "sprites/background11.png", "backgrounds"));
+	backgrounds.push_back(g_resources.texture(ren, "sprites/background12.png", "backgrounds"));
+	backgrounds.push_back(g_resources.texture(ren, "sprites/foreground1.png", "backgrounds"));
+	backgrounds.push_back(g_resources.texture(ren, "sprites/background2.png", "backgrounds"));
+	backgrounds.push_back(g_resources.texture(ren, "sprites/foreground2.png", "backgrounds"));
+	SDL_Surface *zoomSurface{ g_resources.surface("sprites/zoom.png", "backgrounds") };
+	SDL_SetSurfaceBlendMode(zoomSurface, SDL_BLENDMODE_MOD);
+	zoom = g_resources.track(SDL_CreateTextureFromSurface(ren, zoomSurface), "backgrounds", "sprites/zoom.png");
+	g_resources.destroy(zoomSurface);
+}
 
 
+// opens a piece of music to be streamed from disk as it plays, rather than decoded into memory up front. The compressed .ogg or .flac
+// of the named file is used where there is one, falling back to the .wav.
+Mix_Music* loadMusic(const std::string &name)
+{
+	for (const char *extension : { ".ogg", ".flac", ".wav" })
+		if (Mix_Music *music = Mix_LoadMUS((name + extension).c_str()))
+			return music;
+	return nullptr;
+}
 
-// ------------------------------MAIN FUNCTIONS------------------------------
 
-// add an object into the correct groups based on its properties
-void groupInstance(Object* ptr, std::vector<Object*>& instances, std::vector<Object*>& solids, std::vector<Object*>& hazards, std::vector<Object*>& enemies, std::vector<Object*>& collectibles)
+// gets the file path of a level from its number
+std::string levelPath(int levelNum)
 {
-	instances.push_back(ptr); // push onto instances
-	if (ptr->m_solid)
-		solids.push_back(ptr);
-	if (ptr->m_hazard)
-		hazards.push_back(ptr);
-	if (ptr->m_enemy)
-		enemies.push_back(ptr);
-	if (ptr->m_collectible)
-		collectibles.push_back(ptr);
+	std::string path{ "levels/level" };
+	path += std::to_string(levelNum);
+	path += ".txt";
+	return path;
 }
 
 
-// This function is called on level start. It contains the main game loop.
-int play(std::vector<std::vector<Object*>> &level, TTF_Font *font, SDL_Renderer *ren, Mix_Chunk* music, bool weather, int tileSet)
-{
-	// TODO: there are quite a few files loaded in this function, leftover from when this was the main game loop. These are now being loaded
-	// and unloaded each time a new level is presented, which is a waste of time. Pull these out and pass them into the function so all loading
-	// is done at the start of the program.
-
-
-	// ---------------PREP FOR LEVEL START---------------
-	SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-	SDL_RenderClear(ren);
-	SDL_Event e;
-	std::vector<Object*> instances;
-	std::vector<Object*> solids;
-	std::vector<Object*> hazards;
-	std::vector<Object*> enemies;
-	std::vector<Object*> collectibles;
-	std::vector<Object*> protQueue;
-	int startScore{ g_score };
-	int bWidth{ 2 };
-	const SDL_Rect hud1Rect{ 0, 0, screenw, 64 };
-	const SDL_Rect hud2Rect{ 0, 0, screenw, 64 - bWidth };
-	SDL_Texture* scoreText{ SDL_CreateTexture(ren, g_format, SDL_TEXTUREACCESS_STREAMING, 250, 36) };
-	SDL_Texture* livesText{ SDL_CreateTexture(ren, g_format, SDL_TEXTUREACCESS_STREAMING, 150, 36) };
-	SDL_SetTextureBlendMode(rain[0], SDL_BLENDMODE_BLEND);
-	SDL_SetTextureBlendMode(rain[1], SDL_BLENDMODE_BLEND);
-	int lastScore{ -1 };
-	int lastLives{ -1 };
-	int lastgridx(screenw / 64);
-	int lastgridy(level.size() - screenh / 64);
-	bool running = true;
-	bool first = true;
-	static Mix_Chunk* newLife = Mix_LoadWAV("sound/newlife.wav");
-	Mix_VolumeChunk(newLife, MIX_MAX_VOLUME / 2);
-	static Mix_Chunk* death = Mix_LoadWAV("sound/death.wav");
-	Mix_VolumeChunk(death, MIX_MAX_VOLUME / 2);
-	static Mix_Chunk* thunder = Mix_LoadWAV("sound/thunder.wav");
-	Mix_VolumeChunk(thunder, MIX_MAX_VOLUME / 4);
-	Mix_HaltChannel(-1);
-	
-	// find tallest block in 2nd column
-	int y = 0;
-	for (int i(level.size() - 1); i > 0; i--)
+// one life's attempt at a level. Each frame() is one pass of the game loop, drawing and presenting a frame and returning, so the
+// scene loop in main keeps control between frames.
+class Session
+{
+private:
+	Level *m_level{ nullptr };
+	bool m_weather{ false };
+	std::vector<Object*> m_instances;
+	std::vector<Object*> m_solids;
+	std::vector<Object*> m_hazards;
+	std::vector<Object*> m_enemies;
+	std::vector<Object*> m_collectibles;
+	std::vector<Object*> m_protQueue;
+	Player m_player{ 0, 0 };
+	Rain m_rain;
+	int m_lastgridx{ 0 };
+	int m_lastgridy{ 0 };
+	bool m_first{ true };
+	SnapshotRing m_history;
+	Snapshot m_snapshot; // the state the last frame started from
+	Snapshot m_checkpoint;
+	Snapshot m_fallback; // the state before a rewind or checkpoint load, gone back to if the load fails
+	int m_rewind{ 0 }; // ticks to go back by at the start of the next frame
+	bool m_toCheckpoint{ false };
+	bool m_hitchSaved{ false };
+	Uint64 m_frameStart{ 0 }; // when the last frame of this level started
+public:
+	static Mix_Chunk *m_thunder;
+	int m_startScore{ 0 }; // score when the level was started, which it goes back to on death
+	// gets ready to play a level from its start
+	void start(Level &level, bool weather)
 	{
-		if (level.at(i).at(2) != nullptr)
+		m_level = &level;
+		m_weather = weather;
+		m_instances.clear();
+		m_solids.clear();
+		m_hazards.clear();
+		m_enemies.clear();
+		m_collectibles.clear();
+		m_protQueue.clear();
+		m_startScore = g_score;
+		m_lastgridx = screenw / 64;
+		m_lastgridy = level.height() - screenh / 64;
+		m_first = true;
+		m_history.clear();
+		m_snapshot.beginSave();
+		m_checkpoint.beginSave();
+		m_rewind = 0;
+		m_toCheckpoint = false;
+		m_hitchSaved = false;
+		m_frameStart = 0;
+
+		// find tallest block in 2nd column
+		g_levelH = level.height(); // get level size
+		g_levelW = level.width();
+		level.stream(0);
+		int y = 0;
+		for (int i(level.height() - 1); i > 0; i--)
 		{
-			if (!level.at(i).at(2)->m_solid)
+			if (!tileInfo[level.tile(i, 2)].solid)
 			{
 				y = i;
 				break;
 			}
 		}
-		else
+		// start the player on top of this tallest block
+		m_player = Player{ 64, y * 32 };
+	}
+	// strongly reset all objects before level is restarted
+	void end()
+	{
+		m_level->resetStrong();
+	}
+	// passes everything play depends on through a snapshot. The active instance groups are left out, after a load they are rebuilt
+	// about the restored grid position on the next frame. Rain and lightning are only for show and aren't kept either.
+	void sync(Snapshot &s)
+	{
+		int width{ m_level->width() };
+		int height{ m_level->height() };
+		s.sync(width);
+		s.sync(height);
+		if (width != m_level->width() || height != m_level->height()) // taken of another level
 		{
-			y = i;
-			break;
+			s.fail();
+			return;
 		}
+		s.sync(g_count);
+		s.sync(g_score);
+		s.sync(g_lives);
+		s.sync(m_startScore);
+		s.sync(m_lastgridx);
+		s.sync(m_lastgridy);
+		m_player.sync(s);
+		if (s.loading()) // loading can delete objects the groups point to
+		{
+			m_instances.clear();
+			m_solids.clear();
+			m_hazards.clear();
+			m_enemies.clear();
+			m_collectibles.clear();
+		}
+		m_level->sync(s);
+		// protected instances are saved as the cells they spawned in
+		int protectedCount{ s.syncCount(m_protQueue.size()) };
+		if (s.loading())
+			m_protQueue.clear();
+		for (int i{ 0 }; i < protectedCount; i++)
+		{
+			int x{ s.loading() ? 0 : m_protQueue[i]->m_startx / 32 };
+			int y{ s.loading() ? 0 : m_protQueue[i]->m_starty / 32 };
+			s.sync(x);
+			s.sync(y);
+			if (s.loading())
+				if (Object *ptr = m_level->objectAt(x, y))
+					m_protQueue.push_back(ptr);
+		}
+		if (s.loading())
+			m_first = true;
 	}
-	// start the player on top of this tallest block
-	Player player{ 64, y * 32 };
-
-
-	// ---------------LEVEL START SCREEN---------------
-	std::string lives2String{ "x " };
-	lives2String += std::to_string(g_lives);
-
-	// display life count
-	SDL_Texture *lives2Text = SDL_CreateTextureFromSurface(ren, TTF_RenderText_Shaded(font, lives2String.c_str(), { 255, 255, 255 }, { 0, 0, 0 }));
-	SDL_Rect lives2Rect{ screenw / 2 - 20, screenh / 2 + 16, 20 * lives2String.length() - 15, 36 };
-	SDL_RenderCopy(ren, lives2Text, NULL, &lives2Rect);
-	SDL_DestroyTexture(lives2Text);
-
-	// display player sprite
-	SDL_Rect iconRect{ screenw / 2 - 64, screenh / 2 + 16, 32, 32 };
-	SDL_RenderCopy(ren, SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/player.png")), NULL, &iconRect);
-
-	SDL_RenderPresent(ren);
-
-	// play new life music and wait
-	Mix_PlayChannel(0, newLife, -1);
-	for (int i{ 0 }; i < 160; i++)
+	// loads a snapshot of this level, returning false if it didn't hold what a save of this level would
+	bool restore(Snapshot &s)
 	{
-		SDL_PollEvent(&e);
-		SDL_Delay(10);
+		s.beginLoad();
+		sync(s);
+		return s.complete();
 	}
-
-	// begin playing the level's music
-	Mix_FadeInChannel(0, music, -1, 1000);
-
-	// ---------------------------------------------MAIN GAME LOOP---------------------------------------------
-	while (running)
+	// handles a key press meant for the game rather than the player
+	void handleEvent(const SDL_Event &e)
+	{
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) // toggle the profiler overlay
+			g_profiler.m_overlay = !g_profiler.m_overlay;
+		if (e.type == SDL_KEYDOWN && (e.key.keysym.sym == SDLK_F5 || e.key.keysym.sym == SDLK_F6)) // lighter or heavier rain
+		{
+			g_rainDensity = std::min(std::max(g_rainDensity + (e.key.keysym.sym == SDLK_F5 ? -0.1f : 0.1f), 0.0f), 1.0f);
+			m_rain.setDensity(g_rainDensity);
+		}
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F4) // start or stop recording frame timings to csv
+			g_profiler.toggleCsv();
+		if (!g_debugKeys)
+			return;
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F7) // go back three seconds
+			m_rewind = 180;
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F8) // keep the current state as a checkpoint
+			m_checkpoint = m_snapshot;
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F9) // go back to the checkpoint
+			m_toCheckpoint = true;
+	}
+	// plays one frame, returning -1 if the player died, -2 if they quit, 1 if they beat the level and 0 otherwise
+	int frame(SDL_Renderer *ren, GlyphAtlas &text)
 	{
-		while (SDL_PollEvent(&e)) // get events
+		// record the state this frame starts from, or go back to an earlier one
 		{
-			if (e.type == SDL_QUIT) // end the program if quit clicked
+			ScopedTimer timer{ PHASE_SNAPSHOT };
+			// timed from frame to frame here, as the profiler's frame time also covers the intro and death scenes
+			Uint64 now{ SDL_GetPerformanceCounter() };
+			double ms{ m_frameStart ? (now - m_frameStart) * 1000.0 / SDL_GetPerformanceFrequency() : 0 };
+			m_frameStart = now;
+			if (g_hitchMs > 0 && ms > g_hitchMs && !m_hitchSaved && !m_snapshot.empty()) // keep the first hitch
+				m_hitchSaved = m_snapshot.write("hitch.snap");
+			bool rewound{ false }; // the history already ends with a rewound state, so it isn't recorded again
+			if (m_rewind || (m_toCheckpoint && !m_checkpoint.empty()))
+			{
+				// a load that fails part way leaves the world half restored, so the state it started from is put back
+				m_fallback.beginSave();
+				sync(m_fallback);
+				bool loaded{ m_rewind ? m_history.rewind(m_rewind, m_snapshot) && restore(m_snapshot) : restore(m_checkpoint) };
+				if (!loaded)
+					restore(m_fallback);
+				rewound = loaded && m_rewind;
+			}
+			if (!rewound)
 			{
-				g_lives = -2;
-				return 0;
+				m_snapshot.beginSave();
+				sync(m_snapshot);
+				m_history.record(m_snapshot.bytes());
+				g_profiler.set(COUNTER_SNAPSHOT, m_history.lastSize());
 			}
+			m_rewind = 0;
+			m_toCheckpoint = false;
 		}
 
-		int newgridx{ lastgridx };
-		int newgridy{ lastgridy };
+		int newgridx{ m_lastgridx };
+		int newgridy{ m_lastgridy };
 
-		if (!first)
+		if (!m_first)
 		{
-			if (player.v_x == screenw / 2 || newgridx < 0)
-				newgridx = floor(player.getx() / 32);
-			if (player.v_y == screenh / 2 + 64 || newgridy < 0)
-				newgridy = floor(player.gety() / 32);
+			if (m_player.v_x == screenw / 2 || newgridx < 0)
+				newgridx = floor(m_player.getx() / 32);
+			if (m_player.v_y == screenh / 2 + 64 || newgridy < 0)
+				newgridy = floor(m_player.gety() / 32);
 		}
 
 		// instance management
-		for (Object *instance : instances) // fill protected queue
-			if (instance->m_protected && getIndex(&protQueue, instance) == -1) // if protected and not in queue
-			{
-				protQueue.push_back(instance);
-			}
-
-		if (newgridx != lastgridx || newgridy != lastgridy || first) // if player has moved a grid square, reload the active instances
 		{
-			// store a copy of previous instances
-			std::vector<Object*> lastInstances;
-			lastInstances.swap(instances);
-			// empty previous active instances
-			instances.clear(); 
-			solids.clear();
-			hazards.clear();
-			enemies.clear();
-			collectibles.clear();
-			for (int y{ -viewRangeV }; y < viewRangeV + 1; y++) // loop through the region with size viewRange about the new grid coordinate
-			{
-				if (newgridy + y > level.size() - 1 || newgridy + y < 0) // range check to avoid errors
-					continue;
-				for (int x{ -viewRangeH }; x < viewRangeH + 1; x++)
+			ScopedTimer timer{ PHASE_PROTECTED };
+			for (Object *instance : m_instances) // fill protected queue
+				if (instance->m_protected && getIndex(&m_protQueue, instance) == -1) // if protected and not in queue
 				{
-					if (newgridx + x > level.at(newgridy + y).size() - 1 || newgridx + x < 0) // second range check
-						continue;
-					Object *ptr = level[newgridy + y][newgridx + x]; // retrieve object from level array
-					if (ptr) // if an instance found
-					{
-						groupInstance(ptr, instances, solids, hazards, enemies, collectibles); // sort the object into its groups
-					}
-				}
-			}
-			for (Object *ptr : protQueue) // for protected instances
-			{
-				if (getIndex(&instances, ptr) == -1) // if it wasn't loaded in
-				{
-					groupInstance(ptr, instances, solids, hazards, enemies, collectibles); // add it to the active instances
+					m_protQueue.push_back(instance);
 				}
-			}
-			for (Object *instance : lastInstances) // for instances in the last region
-				if (getIndex(&instances, instance) == -1) // if no longer in this region
-					instance->reset(); // reset them to perform normally if reloaded
+		}
+
+		if (newgridx != m_lastgridx || newgridy != m_lastgridy || m_first) // if player has moved a grid square, reload the active instances
+		{
+			ScopedTimer timer{ PHASE_REGION };
+			rebuildRegion(*m_level, newgridx, newgridy, m_protQueue, m_instances, m_solids, m_hazards, m_enemies, m_collectibles);
 		}
 
 		// protected queue cleanup
-		for (int i{ 0 }; i < protQueue.size(); i++) // for every protected instance
-			if (!protQueue[i]->m_protected) // if no longer protected
-			{
-				int igridx{ protQueue[i]->m_startx / 32 };
-				int igridy{ protQueue[i]->m_starty / 32 }; 
-				// check if should be loaded
-				if (igridx < newgridx - viewRangeH - 1 || igridx > newgridx + viewRangeH || igridy < newgridy - viewRangeV || igridy > newgridy + viewRangeV)
+		{
+			ScopedTimer timer{ PHASE_PROTECTED };
+			for (int i{ 0 }; i < m_protQueue.size(); i++) // for every protected instance
+				if (!m_protQueue[i]->m_protected) // if no longer protected
 				{
-					// if not remove it from vectors + cleanup
-					protQueue[i]->reset(); 
-					instances.erase(instances.begin() + getIndex(&instances, protQueue[i]));
-					if (protQueue[i]->m_solid)
-						solids.erase(solids.begin() + getIndex(&solids, protQueue[i]));
-					if (protQueue[i]->m_hazard)
-						hazards.erase(hazards.begin() + getIndex(&hazards, protQueue[i]));
-					if (protQueue[i]->m_enemy)
-						enemies.erase(enemies.begin() + getIndex(&enemies, protQueue[i]));
-					if (protQueue[i]->m_collectible)
-						collectibles.erase(collectibles.begin() + getIndex(&collectibles, protQueue[i]));
+					int igridx{ m_protQueue[i]->m_startx / 32 };
+					int igridy{ m_protQueue[i]->m_starty / 32 }; 
+					// check if should be loaded
+					if (igridx < newgridx - viewRangeH - 1 || igridx > newgridx + viewRangeH || igridy < newgridy - viewRangeV || igridy > newgridy + viewRangeV)
+					{
+						// if not remove it from vectors + cleanup
+						m_protQueue[i]->reset(); 
+						m_instances.erase(m_instances.begin() + getIndex(&m_instances, m_protQueue[i]));
+						if (m_protQueue[i]->m_solid)
+							m_solids.erase(m_solids.begin() + getIndex(&m_solids, m_protQueue[i]));
+						if (m_protQueue[i]->m_hazard)
+							m_hazards.erase(m_hazards.begin() + getIndex(&m_hazards, m_protQueue[i]));
+						if (m_protQueue[i]->m_enemy)
+							m_enemies.erase(m_enemies.begin() + getIndex(&m_enemies, m_protQueue[i]));
+						if (m_protQueue[i]->m_collectible)
+							m_collectibles.erase(m_collectibles.begin() + getIndex(&m_collectibles, m_protQueue[i]));
+					}
+					m_protQueue.erase(m_protQueue.begin() + i--); // erase it from the queue
 				}
-				protQueue.erase(protQueue.begin() + i--); // erase it from the queue
-			}
+		}
 
-		if (first) first = false;
+		if (m_first) m_first = false;
 		SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-		
+	
 		// update the player and store the result
-		int result{ player.update(ren, &solids, &hazards, &enemies, &collectibles) };
+		int result{ 0 };
+		{
+			ScopedTimer timer{ PHASE_PLAYER };
+			result = m_player.update(ren, *m_level, &m_solids, &m_hazards, &m_enemies, &m_collectibles);
+			if (result == -1 && g_invulnerable)
+				result = 0;
+		}
+		{
+			ScopedTimer timer{ PHASE_PROXIMITY };
+			updateProximity(m_instances, m_player);
+		}
 
 		// draw background layers
-		SDL_Rect bgrect{ -320 * floor(player.getx() - player.v_x) / (g_levelW * 32), 0, 960, 480 };
-		SDL_RenderCopyEx(ren, backgrounds[((g_count/120) % 2 == 0)], NULL, &bgrect, 0, NULL, SDL_FLIP_NONE);
+		{
+			ScopedTimer timer{ PHASE_BACKGROUND };
+			SDL_Rect bgrect{ -320 * floor(m_player.getx() - m_player.v_x) / (g_levelW * 32), 0, 960, 480 };
+			SDL_RenderCopyEx(ren, backgrounds[((g_count/120) % 2 == 0)], NULL, &bgrect, 0, NULL, SDL_FLIP_NONE);
 
-		SDL_Rect fgrect{ -640 * floor(player.getx() - player.v_x) / (g_levelW * 32), 0, 1920, 480 };
-		SDL_RenderCopyEx(ren, backgrounds[2], NULL, &fgrect, 0, NULL, SDL_FLIP_NONE);
+			SDL_Rect fgrect{ -640 * floor(m_player.getx() - m_player.v_x) / (g_levelW * 32), 0, 1920, 480 };
+			SDL_RenderCopyEx(ren, backgrounds[2], NULL, &fgrect, 0, NULL, SDL_FLIP_NONE);
+		}
 
-		// update non-solids
-		for (int i{ 0 }; i < instances.size(); i++)
+		// draw non-solid terrain and update non-solids
 		{
-			if (!instances.at(i)->m_solid)
-				instances.at(i)->update(ren, level, &player, &solids, &hazards);
+			ScopedTimer timer{ PHASE_NONSOLID };
+			m_level->drawTiles(ren, m_player.v_x - m_player.getx(), m_player.v_y - m_player.gety(), newgridx, newgridy, false);
+			updateInstances(m_instances, false, ren, *m_level, m_player, m_solids, m_hazards);
 		}
 
 		// draw the player
-		player.draw(ren);
+		m_player.draw(ren);
 
-		// update solids
-		for (int i{ 0 }; i < instances.size(); i++)
+		// draw solid terrain and update solids
 		{
-			if (instances.at(i)->m_solid)
-				instances.at(i)->update(ren, level, &player, &solids, &hazards);
+			ScopedTimer timer{ PHASE_SOLID };
+			m_level->drawTiles(ren, m_player.v_x - m_player.getx(), m_player.v_y - m_player.gety(), newgridx, newgridy, true);
+			updateInstances(m_instances, true, ren, *m_level, m_player, m_solids, m_hazards);
 		}
+		g_profiler.set(COUNTER_INSTANCES, m_instances.size());
+		g_profiler.set(COUNTER_HAZARDS, m_hazards.size());
 
-		lastgridx = newgridx;
-		lastgridy = newgridy;
+		m_lastgridx = newgridx;
+		m_lastgridy = newgridy;
 
 		// draw weather effects
-		if (weather == 1) // rain
+		if (m_weather == 1) // rain
 		{
-			// draws rain images translated to give scrolling effect, the second covering areas missed by the first
-			SDL_Rect rainrect1{ -(player.getx() - player.v_x) % 640, 0, 640, 480 };
-			SDL_Rect rainrect2{ 640 - (player.getx() - player.v_x) % 640, 0, 640, 480 };
-			SDL_RenderCopyEx(ren, rain[g_count / 10 % 2], NULL, &rainrect1, 0, NULL, SDL_FLIP_NONE);
-			SDL_RenderCopyEx(ren, rain[g_count / 10 % 2], NULL, &rainrect2, 0, NULL, SDL_FLIP_NONE);
+			ScopedTimer timer{ PHASE_WEATHER };
+			m_rain.update(m_player.getx() - m_player.v_x);
+			m_rain.draw(ren);
 			if (rand() % 200 == 0) // 1/200 chance every frame to flash lightning
 			{
 				SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
 				SDL_Rect fill{ 0, 0, 640, 480 }; 
 				SDL_RenderFillRect(ren, &fill); // fill screen white for the flash
-				Mix_PlayChannel(-1, thunder, 0); // play thunder sound effect
+				g_audio.play(-1, m_thunder); // play thunder sound effect
 			}
 		}
 
 		// draw GUI borders at the top of the screen
-		SDL_SetRenderDrawColor(ren, 255, 255, 255, 255); // draw in white
-		SDL_RenderFillRect(ren, &hud1Rect); // draw box on top of screen
-		SDL_SetRenderDrawColor(ren, 0, 0, 0, 255); // draw in black
-		SDL_RenderFillRect(ren, &hud2Rect); // fill in majority of the first box
-
-		if (g_score != lastScore) // if score has changed
 		{
-			std::string scoreString{ "SCORE  " }; // construct string and make a texture
-			while (scoreString.length() < 14 - getDigits(g_score))
-				scoreString += '0';
-			scoreString += std::to_string(g_score);
-			stringTexture(font, scoreString, scoreText);
+			ScopedTimer timer{ PHASE_HUD };
+			g_hud.draw(ren, text);
 		}
-		if (g_lives != lastLives) // if lives has changed
+		if (g_profiler.m_overlay)
+			drawProfiler(ren, g_profiler);
+
 		{
-			std::string livesString{ "LIVES  " }; // construct string and make a texture
-			while (livesString.length() < 9 - getDigits(g_lives))
-				livesString += '0';
-			livesString += std::to_string(g_lives);
-			stringTexture(font, livesString, livesText);
+			ScopedTimer timer{ PHASE_PRESENT };
+			g_pacer.present(ren);
 		}
-
-		// draw the score and lives strings
-		SDL_Rect scoreRect{ 40, 10, 240, 36 };
-		SDL_RenderCopy(ren, scoreText, NULL, &scoreRect);
-		SDL_Rect livesRect{ 450, 10, 140, 36 };
-		SDL_RenderCopy(ren, livesText, NULL, &livesRect);
-
-		lastScore = g_score;
-		lastLives = g_lives;
-
-		SDL_RenderPresent(ren);
+		g_input.presented();
+		g_profiler.endFrame();
+		g_audio.tick();
+		if (g_frameHook)
+			g_frameHook();
 		SDL_PumpEvents();
 		g_count++;
-		
-		// if player has died
-		if (result == -1)
-		{
-			// subtract a life
-			g_lives -= 1;
-			// stop the music
-			Mix_HaltChannel(-1);
-			// play the death music
-			Mix_PlayChannel(0, death, -1);
-			// draw death animation
-			for (int i{ 0 }; i < 200; i++)
-			{
-				if (i > 100)
-				{
-					int diameter = 1440 / pow(100, 6) * pow((200 - i), 6); // width of circle to draw about the player
-					SDL_Rect destRect{ player.v_x - (diameter - 32) / 2, player.v_y - (diameter - 32) / 2, diameter, diameter }; // circle rect
-					// four black rects that make up the rest of the animation
-					SDL_Rect rect1{ 0, 0, player.v_x - (diameter - 32) / 2, 480 };
-					SDL_Rect rect2{ player.v_x + 32 + (diameter - 32) / 2, 0, 688 - player.v_x,  480 };
-					SDL_Rect rect3{ player.v_x - (diameter - 32) / 2, 0, diameter, player.v_y - (diameter - 32) / 2 };
-					SDL_Rect rect4{ player.v_x - (diameter - 32) / 2, player.v_y + 32 + (diameter - 32) / 2, diameter, 454 - player.v_y };
-
-					SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
-					SDL_RenderFillRect(ren, &rect1);
-					SDL_RenderFillRect(ren, &rect2);
-					SDL_RenderFillRect(ren, &rect3);
-					SDL_RenderFillRect(ren, &rect4);
-					SDL_RenderCopy(ren, zoom, NULL, &destRect);
-				}
-				SDL_RenderPresent(ren);
-
-				SDL_PollEvent(&e);
-				SDL_Delay(10);
+		return result;
+	}
+	// draws frame i of the 200 frame death animation over the last frame played
+	void drawDeath(SDL_Renderer *ren, int i)
+	{
+			if (i > 100)
+			{
+				int diameter = 1440 / pow(100, 6) * pow((200 - i), 6); // width of circle to draw about the player
+				SDL_Rect destRect{ m_player.v_x - (diameter - 32) / 2, m_player.v_y - (diameter - 32) / 2, diameter, diameter }; // circle rect
+				// four black rects that make up the rest of the animation
+				SDL_Rect rect1{ 0, 0, m_player.v_x - (diameter - 32) / 2, 480 };
+				SDL_Rect rect2{ m_player.v_x + 32 + (diameter - 32) / 2, 0, 688 - m_player.v_x,  480 };
+				SDL_Rect rect3{ m_player.v_x - (diameter - 32) / 2, 0, diameter, m_player.v_y - (diameter - 32) / 2 };
+				SDL_Rect rect4{ m_player.v_x - (diameter - 32) / 2, m_player.v_y + 32 + (diameter - 32) / 2, diameter, 454 - m_player.v_y };
+
+				SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
+				SDL_RenderFillRect(ren, &rect1);
+				SDL_RenderFillRect(ren, &rect2);
+				SDL_RenderFillRect(ren, &rect3);
+				SDL_RenderFillRect(ren, &rect4);
+				SDL_RenderCopy(ren, zoom, NULL, &destRect);
 			}
-			g_score = startScore;
-			break;
-		}
-		// if player has quit the game
-		if (result == -2)
-		{
-			g_lives = -3;
-			return -1;
-		}
-		// if player has beaten the level
-		if (result == 1)
-			return 1;
-		SDL_Delay(10);
 	}
+};
+Mix_Chunk *Session::m_thunder{ nullptr };
 
-	// strongly reset all objects before level is restarted
-	for (std::vector<Object*> row : level)
-		for (Object *instance : row)
-			if (instance != nullptr)
-				instance->resetStrong();
 
-	SDL_DestroyTexture(scoreText);
-	SDL_DestroyTexture(livesText);
-	return 0;
-}
+// This function is called on program start. It manages the start screen and level loading.
+#ifndef BENCHMARK // Benchmark.cpp includes this file and supplies its own main
+// what main's loop is showing
+enum Scene
+{
+	SCENE_MENU,
+	SCENE_LOADING, // waiting for the next level to load
+	SCENE_INTRO, // lives left, before each attempt at a level
+	SCENE_PLAY,
+	SCENE_DEATH,
+	SCENE_QUIT
+};
 
 
-// This function is called on program start. It manages the start screen and level loading.
 int main(int, char**)
 {
 	// ------------------------------SETUP------------------------------
@@ -1791,139 +4311,47 @@ int main(int, char**)
 	SDL_Renderer *ren{ SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC) };
 	TTF_Init();
 	IMG_Init(IMG_INIT_PNG);
-	Mix_Init(MIX_INIT_FLAC);
-	Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 1, 1024);
+	Mix_Init(MIX_INIT_OGG | MIX_INIT_FLAC);
+	if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 1, 1024) == 0)
+		g_audio.start();
 	g_format = SDL_GetWindowPixelFormat(win);
+	g_jobs.start(std::thread::hardware_concurrency());
+	keys = g_input.keys();
 	int SDL_EnableKeyRepeat(2);
 	TTF_Font *font = TTF_OpenFont("arcadeclassic/ARCADECLASSIC.ttf", 36);
-	std::vector<std::vector<int>> preLevel;
-	std::vector<std::vector<Object*>> level;
+	GlyphAtlas text;
+	text.build(ren, font);
+	TTF_Font *smallFont = TTF_OpenFont("arcadeclassic/ARCADECLASSIC.ttf", 16);
+	g_smallText.build(ren, smallFont);
+	g_hud.build(ren);
+	Level *level{ new Level };
+	Preloader preloader;
 	int levelNum{ 0 };
-	bool first{ true };
 	bool weather{ false };
 	int track{ 0 };
 	int tileSet{ 0 };
 
 	// ------------------------------LOADING IMAGES------------------------------
-	Player::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/player.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/player1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/player2.png"))
-	};
-	Wall::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/wall1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/top1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/left1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/bottom1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/right1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/wall2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/top2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/left2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/bottom2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/right2.png"))
-	};
-	Water::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/water1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/water2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/water3.png"))
-	};
-	Thorns::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/thorns.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/icicle.png"))
-	};
-	Ice::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/iceTop.png"))
-	};
-	ThinIce::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/iceThin1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/iceThin2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/iceThin3.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/iceThin4.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/water1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/water2.png"))
-	};
-	Tree::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/tree1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/tree2.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/tree3.png"))
-	};
-	Flower::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/flower1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/flower2.png"))
-	};
-	Snake::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/snake1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/snake2.png"))
-	};
-	Ptero::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/ptero1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/ptero2.png"))
-	};
-	Frog::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/frog1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/frog2.png"))
-	};
-	Spore::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/spore.png"))
-	};
-	Snowball::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/snowball.png"))
-	};
-	Plant::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/plant1.png"))
-	};
-	Spit::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/spit1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/spit2.png"))
-	};
-	Yeti::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/yeti.png"))
-	};
-	Gem100::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/gem1001.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/gem1002.png"))
-	};
-	GemL::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/gemL1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/gemL2.png"))
-	};
-	Mushroom::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/mushroom1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/mushroom2.png"))
-	};
-	Mammoth::m_imageSet = {
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/mammoth1.png")),
-		SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/mammoth2.png"))
-	};
-	backgrounds.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/background11.png")));
-	backgrounds.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/background12.png")));
-	backgrounds.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/foreground1.png")));
-	backgrounds.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/background2.png")));
-	backgrounds.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/foreground2.png")));
-	rain.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/rain1.tga")));
-	rain.push_back(SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/rain2.tga")));
-	SDL_Surface *zoomSurface{ IMG_Load("sprites/zoom.png") };
-	SDL_SetSurfaceBlendMode(zoomSurface, SDL_BLENDMODE_MOD);
-	zoom = SDL_CreateTextureFromSurface(ren, zoomSurface);
-	SDL_Texture *start{ SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/startScreen.png")) };
-	SDL_Texture *border{ SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/border.png")) };
-	std::vector<SDL_Texture*> startButton{ SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/start1.png")), SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/start2.png")) };
-	std::vector<SDL_Texture*> exitButton{ SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/exit1.png")), SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/exit2.png")) };
-	SDL_Texture *demo{ SDL_CreateTextureFromSurface(ren, IMG_Load("sprites/demo.png")) };
+	loadImages(ren);
+	SDL_Texture *start{ g_resources.texture(ren, "sprites/startScreen.png", "menu") };
+	SDL_Texture *border{ g_resources.texture(ren, "sprites/border.png", "menu") };
+	std::vector<SDL_Texture*> startButton{ g_resources.texture(ren, "sprites/start1.png", "menu"), g_resources.texture(ren, "sprites/start2.png", "menu") };
+	std::vector<SDL_Texture*> exitButton{ g_resources.texture(ren, "sprites/exit1.png", "menu"), g_resources.texture(ren, "sprites/exit2.png", "menu") };
+	SDL_Texture *demo{ g_resources.texture(ren, "sprites/demo.png", "menu") };
 
 	// ------------------------------LOADING SOUNDS------------------------------
-	std::vector<Mix_Chunk*> music{ Mix_LoadWAV("sound/music/journey's start.wav"), Mix_LoadWAV("sound/music/raindrop march.wav") };
+	std::vector<Mix_Music*> music{ loadMusic("sound/music/journey's start"), loadMusic("sound/music/raindrop march") };
 	Player::m_sounds =
 	{
-		Mix_LoadWAV("sound/gem.wav"),
-		Mix_LoadWAV("sound/jump.wav")
+		g_resources.sound("sound/gem.wav", "sounds"),
+		g_resources.sound("sound/jump.wav", "sounds")
 	};
 	for (Mix_Chunk *sound : Player::m_sounds)
 		Mix_VolumeChunk(sound, MIX_MAX_VOLUME/2);
-	for (Mix_Chunk *track : music)
-	{
-		Mix_VolumeChunk(track, MIX_MAX_VOLUME / 4);
-	}
+	Mix_Music *newLife{ loadMusic("sound/newlife") };
+	Mix_Music *death{ loadMusic("sound/death") };
+	Session::m_thunder = g_resources.sound("sound/thunder.wav", "sounds");
+	Mix_VolumeChunk(Session::m_thunder, MIX_MAX_VOLUME / 4);
 
 	// ------------------------------MAIN MENU------------------------------
 	SDL_Rect bgrect = { 100, 0, 320, 240 };
@@ -1934,11 +4362,7 @@ int main(int, char**)
 	SDL_Rect hiscoreBorder = { 168, 68, 304, 304 };
 	SDL_Rect mouseRect = { 0, 0, 1, 1 };
 	SDL_Rect hiscoreRect = { 170, 70, 300, 300 };
-	SDL_Texture* hiscores{ SDL_CreateTexture(ren, g_format, SDL_TEXTUREACCESS_STREAMING, 216, 216) };
-	
-	// play menu music
-	Mix_HaltChannel(-1);
-	Mix_FadeInChannel(0, music[0], -1, 1000);
+	SDL_Texture* hiscores{ g_resources.track(SDL_CreateTexture(ren, g_format, SDL_TEXTUREACCESS_STREAMING, 216, 216), "menu", "hiscores") };
 	
 	// dummy player variables
 	bool flip{ false };
@@ -1946,221 +4370,220 @@ int main(int, char**)
 	int dir{ 1 };
 	int frame{ 0 };
 
-	// main menu loop
-	bool running{ true };
-	while (running)
-	{
-		SDL_RenderCopy(ren, backgrounds[((g_count++) / 120 % 2 == 0)], &bgrect, NULL); // draw background
-		SDL_RenderCopy(ren, backgrounds[2], &bgrect, NULL); // draw foreground
-		if ((g_count + 23) / 22 % 20 == 0) // make title bounce
-			titleRect.y += (g_count) % 11 - 5;
-		// make player sprite walk back and forth
-		if (g_count % 120 == 0) 
-		{
-			walkCount += rand() % 40 + 20; // walk a random distance
-			dir = pow(-1, rand() % 2); // in a random direction
-			frame = 1;
-			// make sprite face correct way
-			if (dir == -1)
-				flip = true;
-			else
-				flip = false;
-		}
-		if (walkCount > 0) // if walking
-		{
-			walkCount -= 1;
-			playerRect.x += dir; // update pos
-			if (g_count % 6 == 0) // animate
-				frame = frame % 2 + 1;
-		}
-		else
-			frame = 0;
+	// play menu music
+	g_audio.halt(-1);
+	g_audio.playMusic(music[0], MIX_MAX_VOLUME / 4, 1000);
+
+	// the game's scenes are states of this one loop. Each draws a frame and returns to it, so events are handled, the next level
+	// carries on loading and sounds carry on being posted whatever is on screen.
+	Scene scene{ SCENE_MENU };
+	Session session;
+	Uint32 introStart{ 0 }; // ticks when the level intro was shown
+	int deathFrame{ 0 };
+	// shows the lives left before the level starts, playing it from the start
+	auto startIntro = [&]() {
+		session.start(*level, weather);
+		g_audio.halt(-1);
+		g_audio.playMusic(newLife, MIX_MAX_VOLUME / 2);
+		introStart = SDL_GetTicks();
+		scene = SCENE_INTRO;
+	};
+	// goes back to the main menu
+	auto startMenu = [&]() {
+		playerRect = { 304, 416, 32, 32 };
+		g_audio.halt(-1);
+		g_audio.playMusic(music[0], MIX_MAX_VOLUME / 4, 1000);
+		scene = SCENE_MENU;
+	};
+	while (scene != SCENE_QUIT)
+	{
+		// wait before polling rather than after presenting, so that input is as fresh as it can be when the frame is built
+		g_pacer.wait();
 
-		// draw menu elements
+		// loop through events
 		SDL_GetMouseState(&mouseRect.x, &mouseRect.y);
-		SDL_RenderCopy(ren, start, NULL, &titleRect);
-		SDL_RenderCopy(ren, startButton[(collided(mouseRect, startRect))], NULL, &startRect);
-		SDL_RenderCopy(ren, exitButton[(collided(mouseRect, exitRect))], NULL, &exitRect);
-		SDL_RenderCopyEx(ren, Player::m_imageSet[frame], NULL, &playerRect, NULL, NULL, static_cast<SDL_RendererFlip>(flip));
-		SDL_RenderCopy(ren, demo, NULL, NULL);
+		{
+			ScopedTimer timer{ PHASE_EVENTS };
+			SDL_Event e;
+			while (SDL_PollEvent(&e))
+			{
+				g_input.handle(e);
+				// if close clicked
+				if (e.type == SDL_QUIT)
+					scene = SCENE_QUIT;
+				else if (e.type == SDL_RENDER_TARGETS_RESET) // the hud texture lost its contents
+					g_hud.invalidate();
+				else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F10) // log what is loaded and how much memory it takes
+					g_resources.report();
+				else if (scene == SCENE_PLAY)
+					session.handleEvent(e);
+				else if (scene == SCENE_MENU)
+				{
+					// if exit game clicked
+					if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && collided(mouseRect, exitRect))
+						scene = SCENE_QUIT; // end the program
+					// if play game clicked, start main game setup
+					else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN || e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && collided(mouseRect, startRect))
+					{
+						// game setup
+						g_score = 0;
+						g_lives = 3;
+						levelNum = 1;
+						scene = SCENE_LOADING;
+					}
+				}
+			}
+			g_input.tick();
+		}
 
-		// loop through events
-		SDL_Event e;
-		while (SDL_PollEvent(&e))
+		switch (scene)
 		{
-			// if exit game clicked
-			if (e.type == SDL_QUIT || e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && collided(mouseRect, exitRect))
+		case SCENE_MENU:
+		{
+			SDL_RenderCopy(ren, backgrounds[((g_count++) / 120 % 2 == 0)], &bgrect, NULL); // draw background
+			SDL_RenderCopy(ren, backgrounds[2], &bgrect, NULL); // draw foreground
+			if ((g_count + 23) / 22 % 20 == 0) // make title bounce
+				titleRect.y += (g_count) % 11 - 5;
+			// make player sprite walk back and forth
+			if (g_count % 120 == 0) 
+			{
+				walkCount += rand() % 40 + 20; // walk a random distance
+				dir = pow(-1, rand() % 2); // in a random direction
+				frame = 1;
+				// make sprite face correct way
+				if (dir == -1)
+					flip = true;
+				else
+					flip = false;
+			}
+			if (walkCount > 0) // if walking
 			{
-				running = false; // end the program
+				walkCount -= 1;
+				playerRect.x += dir; // update pos
+				if (g_count % 6 == 0) // animate
+					frame = frame % 2 + 1;
+			}
+			else
+				frame = 0;
+
+			// draw menu elements
+			SDL_RenderCopy(ren, start, NULL, &titleRect);
+			SDL_RenderCopy(ren, startButton[(collided(mouseRect, startRect))], NULL, &startRect);
+			SDL_RenderCopy(ren, exitButton[(collided(mouseRect, exitRect))], NULL, &exitRect);
+			SDL_RenderCopyEx(ren, Player::m_imageSet[frame], NULL, &playerRect, NULL, NULL, static_cast<SDL_RendererFlip>(flip));
+			SDL_RenderCopy(ren, demo, NULL, NULL);
+			g_pacer.present(ren);
+			break;
+		}
+		case SCENE_LOADING:
+		{
+			// wait on a black screen for the level to load on the preloader's thread. It has usually been loaded while the last was
+			// played, the first level of a game is the exception.
+			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+			SDL_RenderClear(ren);
+			g_pacer.present(ren);
+			if (!preloader.loading(levelPath(levelNum)))
+				preloader.start(levelPath(levelNum), ren, nullptr);
+			if (!preloader.ready())
 				break;
+			// take the level from the preloader and start preloading the one after it while this one is played. The level's
+			// objects are otherwise created chunk by chunk as the player approaches them.
+			Level *last{ level };
+			level = preloader.take(levelPath(levelNum), ren, &tileSet, &weather, &track);
+			g_resources.beginLevel(); // anything made from here on should be gone when the level ends
+			if (levelNum < 8)
+				preloader.start(levelPath(levelNum + 1), ren, last);
+			else
+				delete last;
+			startIntro();
+			break;
+		}
+		case SCENE_INTRO:
+		{
+			// display life count and player sprite
+			SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+			SDL_RenderClear(ren);
+			char lives2String[32];
+			snprintf(lives2String, sizeof(lives2String), "x %d", g_lives);
+			text.draw(ren, lives2String, screenw / 2 - 20, screenh / 2 + 16);
+			SDL_Rect iconRect{ screenw / 2 - 64, screenh / 2 + 16, 32, 32 };
+			SDL_RenderCopy(ren, Player::m_imageSet[0], NULL, &iconRect);
+			g_pacer.present(ren);
+			// begin playing the level's music once the new life music has had its time
+			if (SDL_GetTicks() - introStart >= 1600)
+			{
+				g_audio.playMusic(music[track], MIX_MAX_VOLUME / 4, 1000);
+				scene = SCENE_PLAY;
+			}
+			break;
+		}
+		case SCENE_PLAY:
+		{
+			int result{ session.frame(ren, text) };
+			if (result == -1) // if player has died
+			{
+				// subtract a life
+				g_lives -= 1;
+				// stop the sounds
+				g_audio.halt(-1);
+				// play the death music in place of the level's
+				g_audio.playMusic(death, MIX_MAX_VOLUME / 2);
+				deathFrame = 0;
+				scene = SCENE_DEATH;
 			}
-			// if play game clicked, start main game setup
-			if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN || e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && collided(mouseRect, startRect))
+			else if (result == -2) // if player has quit the game
 			{
-				// game setup
-				g_score = 0;
-				g_lives = 3;
-				levelNum = 0;
-				first = true;
-
-				// level control loop
-				while (true)
+				g_resources.endLevel(levelNum);
+				startMenu();
+			}
+			else if (result == 1) // if player has beaten the level
+			{
+				g_resources.endLevel(levelNum);
+				if (levelNum == 8) // if final level completed
+					startMenu();
+				else
 				{
-					while (g_lives >= 0)
-						// play the level, if the player beats it then load the next, if not then play the same level.
-						if (first == true || play(level, font, ren, music[track], weather, tileSet) == 1)
-						{
-							if (first)
-								first = false;
-							if (levelNum == 8) // if final level completed
-							{
-								g_lives = -3; // return to main menu
-								break;
-							}
-							// construct file path for level to load
-							std::string path{ "levels/level" };
-							path += std::to_string(++levelNum);
-							path += ".txt";
-							// Load file into prelevel and get parameters. prelevel is an array of integers corresponding to the objects the
-							// level is to be filled with
-							loadLevel(&preLevel, &tileSet, &weather, &track, path); 
-							g_levelH = preLevel.size(); // get level size
-							g_levelW = preLevel.at(0).size();
-							for (int y{ 0 }; y < level.size(); y++) // empty previous level vector
-							{
-								for (int x{ 0 }; x < level[y].size(); x++)
-									delete level[y][x];
-							}
-							level.clear(); // reset level sizes
-							for (int y{ 0 }; y < preLevel.size(); y++) // construct new level vector
-							{
-								level.push_back({});
-								for (int x{ 0 }; x < preLevel.at(y).size(); x++)
-								{
-									Object* ptr{ 0 };
-									// create the object indicated in prelevel at the correct position, and pass a pointer to it into the
-									// level array
-									switch (tileSet)
-									{
-									case 0:
-										switch (preLevel.at(y).at(x))
-										{
-										case 1:
-											ptr = new Wall(x * 32, y * 32, ren);
-											ptr->setFrame(tileSet * 5);
-											break;
-										case 2:
-											ptr = new Water(x * 32, y * 32, ren);
-											break;
-										case 3:
-											ptr = new Thorns(x * 32, y * 32, ren);
-											ptr->setFrame(tileSet);
-											break;
-										case 4:
-											ptr = new Gem100(x * 32, y * 32, ren);
-											break;
-										case 5:
-											ptr = new GemL(x * 32, y * 32, ren);
-											break;
-										case 6:
-											ptr = new Snake(x * 32, y * 32, ren);
-											break;
-										case 7:
-											ptr = new Ptero(x * 32, y * 32, ren);
-											break;
-										case 8:
-											ptr = new Plant(x * 32, y * 32, ren);
-											break;
-										case 9:
-											ptr = new Spit(x * 32, y * 32, ren);
-											break;
-										case 10:
-											ptr = new Mushroom(x * 32, y * 32, ren);
-											break;
-										case 11:
-											ptr = new Tree(x * 32, y * 32, ren);
-											break;
-										case 12:
-											ptr = new Flower(x * 32, y * 32, ren);
-											break;
-										case 13:
-											ptr = new Frog(x * 32, y * 32, ren);
-											break;
-										}
-										level.at(y).push_back(ptr);
-										break;
-									case 1:
-										switch (preLevel.at(y).at(x))
-										{
-										case 1:
-											ptr = new Wall(x * 32, y * 32, ren);
-											ptr->setFrame(tileSet * 5);
-											break;
-										case 2:
-											ptr = new Water(x * 32, y * 32, ren);
-											break;
-										case 3:
-											ptr = new Thorns(x * 32, y * 32, ren);
-											ptr->setFrame(tileSet);
-											break;
-										case 4:
-											ptr = new Gem100(x * 32, y * 32, ren);
-											break;
-										case 5:
-											ptr = new GemL(x * 32, y * 32, ren);
-											break;
-										case 6:
-											ptr = new Ice(x * 32, y * 32, ren);
-											break;
-										case 7:
-											ptr = new ThinIce(x * 32, y * 32, ren);
-											break;
-										case 8:
-											ptr = new Mammoth(x * 32, y * 32, ren);
-											break;
-										case 9:
-											ptr = new Yeti(x * 32, y * 32, ren);
-											break;
-										}
-										level.at(y).push_back(ptr);
-										break;
-									}
-								}
-							}
-						}
-					if (g_lives == -1) // on game over
-					{
-						g_score = 0; // reset score
-						g_lives = 3; // reset lives
-					}
-					else if (g_lives == -2) // close clicked
-					{
-						running = false; // exit program
-						break;
-					}
-					else if (g_lives == -3) // exit to main menu
-					{
-						playerRect = { 304, 416, 32, 32 };
-						Mix_HaltChannel(-1);
-						Mix_FadeInChannel(0, music[0], -1, 1000);
-						break;
-					}
+					levelNum++;
+					scene = SCENE_LOADING;
 				}
 			}
+			break;
+		}
+		case SCENE_DEATH:
+		{
+			session.drawDeath(ren, deathFrame++);
+			g_pacer.present(ren);
+			if (deathFrame < 200)
+				break;
+			g_score = session.m_startScore;
+			session.end();
+			if (g_lives < 0) // on game over play the level again from a fresh start
+			{
+				g_score = 0; // reset score
+				g_lives = 3; // reset lives
+			}
+			startIntro();
+			break;
+		}
+		default:
+			break;
 		}
-		SDL_RenderPresent(ren);
-		SDL_Delay(10);
 	}
 
 	// prep for program end
-	for (Mix_Chunk *track : music)
-	{
-		Mix_FreeChunk(track);
-	}
-	for (Mix_Chunk *sound : Player::m_sounds)
+	delete level;
+	g_audio.stop();
+	Mix_HaltMusic();
+	for (Mix_Music *track : music)
 	{
-		Mix_FreeChunk(sound);
+		Mix_FreeMusic(track);
 	}
+	Mix_FreeMusic(newLife);
+	Mix_FreeMusic(death);
+	g_hud.destroy();
+	text.destroy();
+	g_smallText.destroy();
+	g_resources.destroyAll(); // every texture and sound chunk left
 	Mix_CloseAudio();
 	SDL_DestroyRenderer(ren);
 	SDL_DestroyWindow(win);
@@ -2171,3 +4594,4 @@ int main(int, char**)
 
 	return 0;
 }
+#endif